@@ -0,0 +1,31 @@
+#include "Analyzer.h"
+#include "Trace.h"
+#include <algorithm>
+
+void AnalyzeSpectrum(complex_sample& samples, const AnalysisSettings& settings, std::vector<float>& magnitudes, FrameArena& arena)
+{
+	TRACE_SCOPE("AnalyzeSpectrum");
+	ApplyWindow(samples, settings.window);
+	FFT(samples, arena);
+
+	const size_t bins = samples.size() / 2; //the top half mirrors the bottom one for real input
+	ArenaVector<float> spectrum(bins, 0.0f, arena);
+	for (size_t i = 0; i < bins; ++i)
+		spectrum[i] = std::abs(samples[i]);
+	const size_t chartbins = settings.chartBins;
+	magnitudes.assign(chartbins, 0.0f);
+	if (bins == 0)
+		return;
+
+	//magnitudes grow with the fft size, scale back to what a 2048 point fft gives so the chart doesn't jump around
+	const float scale = 2048.0f / (float)samples.size();
+	for (size_t i = 0; i < chartbins; ++i)
+	{
+		size_t first = i * bins / chartbins;
+		size_t last = std::max(first + 1, (i + 1) * bins / chartbins);
+		float peak = 0.0f;
+		for (size_t bin = first; bin < last && bin < bins; ++bin)
+			peak = std::max(peak, spectrum[bin]);
+		magnitudes[i] = peak * scale;
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef WINORB_ANALYZER_H
+#define WINORB_ANALYZER_H
+
+#include "FFT.h"
+#include <vector>
+
+//the chart gets this many bins unless the overlay says otherwise, whatever the fft size is
+const size_t kDefaultChartBins = 1024;
+
+//the knobs that trade throughput for resolution, tweakable live from the overlay
+struct AnalysisSettings
+{
+	static const size_t kMinFFTSize = 256;
+	static const size_t kMaxFFTSize = 8192;
+	static const size_t kMinChartBins = 64;
+	static const size_t kMaxChartBins = 32768; //past 65536 vertices, the chart switches to 32 bit indices
+	size_t fftSize = 2048;
+	size_t chartBins = kDefaultChartBins; //powers of two from the overlay, anything >= 2 works
+	WindowFunction window = WindowFunction::Rectangular;
+	size_t hopSize = 0; //new samples needed before analyzing again, 0 analyzes every frame
+	bool gpuFFT = true; //use fft.comp when the device supports this size, the cpu fft otherwise
+	float idleAfter = 10.0f; //seconds of silence before analysis and rendering stop until sound comes back, 0 never idles
+	bool beatTracking = true; //onsets and tempo off the cpu spectrum, with the gpu fft off a small cpu fft of the newest samples
+	bool pitchTracking = true; //the note being sung/played, off the raw samples
+};
+
+//windows and FFTs the samples in place, then maps the positive half of the spectrum onto settings.chartBins
+//the fft's scratch comes out of the arena, callers move it on to the next frame themselves
+void AnalyzeSpectrum(complex_sample& samples, const AnalysisSettings& settings, std::vector<float>& magnitudes, FrameArena& arena);
+
+#endif //!WINORB_ANALYZER_H
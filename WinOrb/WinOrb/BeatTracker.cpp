@@ -0,0 +1,196 @@
+#include "BeatTracker.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	const float kCompression = 10.0f; //log(1 + k * magnitude), how much quiet bands count next to loud ones
+	const float kThresholdScale = 1.5f; //of the moving median
+	const float kThresholdFloor = 0.02f; //flux that's never an onset, keeps noise and near silence quiet
+	const float kThresholdPeak = 0.1f; //of the recent peak flux
+	const float kPeakDecay = 0.998f; //per frame, a few seconds at the usual 100 frames a second
+	const int64_t kMinOnsetGapUs = 60000;
+	const float kAutocorrelationDecay = 1.0f - 1.0f / (TempoTracker::kEnvelopeRate * 6); //about the last 6 seconds
+	const float kPreferredLag = 60.0f * TempoTracker::kEnvelopeRate / 120.0f;
+	const float kTempoOctaves = 1.0f; //width of the weighting around 120bpm
+	const float kMinConfidence = 0.1f;
+	const float kTempoHysteresis = 1.2f;
+	const float kPhaseGain = 0.3f; //how much of the error an onset near a beat takes out
+	const float kPhaseWindow = 0.2f; //onsets further than this (in beats) from one don't move the phase
+	const float kMaxGapSeconds = 2.0f; //longer than this between frames (idle, a hitch) and the envelope just skips ahead
+}
+
+void OnsetDetector::SetBins(size_t bins)
+{
+	//bin 0 is dc, log spaced from bin 1 up so the bass gets as many bands as the treble
+	mBins = bins;
+	mEdges[0] = bins > 1 ? 1 : 0;
+	for (size_t b = 1; b <= kBands; ++b)
+	{
+		uint32_t edge = (uint32_t)powf((float)bins, (float)b / kBands);
+		mEdges[b] = (uint32_t)std::min<size_t>(std::max(edge, mEdges[b - 1] + 1), bins);
+	}
+	mEdges[kBands] = (uint32_t)bins;
+	mFrames = 0;
+	mFlux[0] = 0.0f;
+	mFlux[1] = 0.0f;
+	mPeak = 0.0f;
+	mNovelty = 0.0f;
+}
+
+float OnsetDetector::Process(const float* magnitudes, size_t bins, int64_t us, bool& onset, float& strength)
+{
+	onset = false;
+	strength = 0.0f;
+	if (bins != mBins)
+		SetBins(bins);
+
+	//half wave rectified, only bands getting louder count
+	float flux = 0.0f;
+	for (size_t b = 0; b < kBands; ++b)
+	{
+		uint32_t first = mEdges[b];
+		uint32_t last = mEdges[b + 1];
+		if (last <= first)
+			continue;
+		float sum = 0.0f;
+		for (uint32_t i = first; i < last; ++i)
+			sum += magnitudes[i];
+		float level = log1pf(kCompression * sum / (last - first));
+		if (mFrames > 0)
+			flux += std::max(0.0f, level - mBands[b]);
+		mBands[b] = level;
+	}
+	flux /= kBands;
+
+	float sorted[kMedianFrames];
+	size_t count = std::min(mFrames, kMedianFrames);
+	std::copy(mHistory, mHistory + count, sorted);
+	float median = 0.0f;
+	if (count > 0)
+	{
+		std::nth_element(sorted, sorted + count / 2, sorted + count);
+		median = sorted[count / 2];
+	}
+	mPeak = std::max(flux, mPeak * kPeakDecay);
+	float threshold = kThresholdScale * median + std::max(kThresholdFloor, kThresholdPeak * mPeak);
+
+	//the last frame was a peak if it cleared the threshold and this one's lower
+	float candidate = mFlux[1];
+	if (mFrames >= 3 && candidate > threshold && candidate >= mFlux[0] && candidate > flux && us - mLastOnsetUs >= kMinOnsetGapUs)
+	{
+		onset = true;
+		strength = candidate - threshold;
+		mLastOnsetUs = us;
+	}
+
+	mNovelty = std::max(0.0f, flux - median);
+	mHistory[mFrames % kMedianFrames] = flux;
+	mFlux[0] = mFlux[1];
+	mFlux[1] = flux;
+	++mFrames;
+	return flux;
+}
+
+void TempoTracker::AddEnvelope(float value)
+{
+	mEnvelope[mSamples % kEnvelopeLength] = value;
+	for (size_t lag = kMinLag - 1; lag <= kMaxLag && lag <= mSamples; ++lag)
+		mAutocorrelation[lag] = kAutocorrelationDecay * mAutocorrelation[lag] + value * mEnvelope[(mSamples - lag) % kEnvelopeLength];
+	mEnergy = kAutocorrelationDecay * mEnergy + value * value;
+	++mSamples;
+}
+
+void TempoTracker::Estimate(RhythmState& state)
+{
+	size_t best = 0;
+	float bestscore = 0.0f;
+	float currentscore = 0.0f;
+	for (size_t lag = kMinLag; lag <= kMaxLag; ++lag)
+	{
+		float octaves = log2f(lag / kPreferredLag) / kTempoOctaves;
+		float score = mAutocorrelation[lag] * expf(-0.5f * octaves * octaves);
+		if (score > bestscore)
+		{
+			bestscore = score;
+			best = lag;
+		}
+		if (lag + 1 >= mLag && lag <= mLag + 1)
+			currentscore = std::max(currentscore, score);
+	}
+	//half and double tempo score close on a lot of music, only jump away from the current one (drifting to a lag
+	//next to it is fine) for something clearly better
+	bool jump = best + 1 < mLag || best > mLag + 1;
+	if (mLag != 0 && jump && bestscore < kTempoHysteresis * currentscore)
+		best = mLag;
+	mLag = best;
+	state.confidence = best != 0 && mEnergy > 1e-9f ? std::min(1.0f, mAutocorrelation[best] / mEnergy) : 0.0f;
+	if (state.confidence < kMinConfidence)
+		return;
+
+	//between lags, off a parabola through the peak and its neighbours
+	float offset = 0.0f;
+	if (best > kMinLag && best < kMaxLag)
+	{
+		float before = mAutocorrelation[best - 1];
+		float peak = mAutocorrelation[best];
+		float after = mAutocorrelation[best + 1];
+		float curve = before - 2.0f * peak + after;
+		if (curve < 0.0f)
+			offset = std::min(0.5f, std::max(-0.5f, 0.5f * (before - after) / curve));
+	}
+	state.bpm = 60.0f * kEnvelopeRate / (best + offset);
+}
+
+void TempoTracker::Process(float novelty, bool onset, int64_t us, RhythmState& state)
+{
+	if (!mStarted)
+	{
+		mStarted = true;
+		mLastUs = us;
+	}
+	float dt = std::min(kMaxGapSeconds, std::max(0.0f, (us - mLastUs) / 1e6f));
+	mLastUs = us;
+
+	//frames come whenever the capture has a new window, the envelope wants a steady rate. a sample takes the
+	//strongest novelty since the last one, the samples a slow frame skipped over stay 0
+	mPending = std::max(mPending, novelty);
+	mClock += dt * kEnvelopeRate;
+	while ((double)mSamples + 1.0 <= mClock)
+	{
+		AddEnvelope(mPending);
+		mPending = 0.0f;
+	}
+	Estimate(state);
+
+	if (state.bpm <= 0.0f)
+		return;
+	state.beatPhase += dt * state.bpm / 60.0f;
+	if (onset)
+	{
+		//how far off the nearest beat, in beats. a phase that already wrapped is running ahead and gets pulled back,
+		//one just short of wrapping gets pushed forward
+		float error = state.beatPhase - floorf(state.beatPhase + 0.5f);
+		if (fabsf(error) < kPhaseWindow)
+			state.beatPhase = std::max(0.0f, state.beatPhase - kPhaseGain * error);
+	}
+	while (state.beatPhase >= 1.0f)
+	{
+		state.beatPhase -= 1.0f;
+		++state.beats;
+	}
+}
+
+const RhythmState& BeatTracker::Process(const float* magnitudes, size_t bins, int64_t us)
+{
+	bool onset = false;
+	float strength = 0.0f;
+	mOnsets.Process(magnitudes, bins, us, onset, strength);
+	if (onset)
+	{
+		++mState.onsets;
+		mState.onsetStrength = strength;
+	}
+	mTempo.Process(mOnsets.Novelty(), onset, us, mState);
+	return mState;
+}
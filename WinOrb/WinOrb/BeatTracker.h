@@ -0,0 +1,85 @@
+#ifndef WINORB_BEAT_TRACKER_H
+#define WINORB_BEAT_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//what the beat tracker knows after a frame. the counters only ever go up, so whoever looks at it late (the
+//renderer skipping packets, a process reading shared memory) still sees that onsets or beats happened since
+struct RhythmState
+{
+	uint64_t onsets = 0;
+	uint64_t beats = 0;
+	float onsetStrength = 0.0f; //of the newest onset, how far the flux peak cleared the threshold
+	float bpm = 0.0f; //0 until there's been enough going on to tell
+	float beatPhase = 0.0f; //0 right on a beat up to 1 just before the next
+	float confidence = 0.0f; //how periodic the onsets are at bpm, 0 to 1
+};
+
+//spectral flux onsets: the chart magnitudes squeezed into log spaced bands and log compressed, the summed increase
+//of every band since the last frame, and a peak of that above a moving median of the recent flux (and a fraction of
+//the loudest recent flux, so the noise between hits in a quiet stretch doesn't count) is an onset.
+//the peak is only known once the next frame is lower, so onsets come out a frame late
+class OnsetDetector
+{
+public:
+	static const size_t kBands = 32;
+	static const size_t kMedianFrames = 32;
+	//the flux of this frame, true if the one before it was an onset
+	float Process(const float* magnitudes, size_t bins, int64_t us, bool& onset, float& strength);
+	//flux above the moving median, the onset envelope the tempo gets worked out of
+	float Novelty() const { return mNovelty; };
+private:
+	void SetBins(size_t bins);
+	size_t mBins = 0;
+	uint32_t mEdges[kBands + 1] = {};
+	float mBands[kBands] = {};
+	float mHistory[kMedianFrames] = {}; //flux ring
+	size_t mFrames = 0;
+	float mFlux[2] = {}; //the last two frames', to tell a peak
+	float mPeak = 0.0f; //slowly decaying max of the flux, the threshold never drops below a fraction of it
+	int64_t mLastOnsetUs = 0;
+	float mNovelty = 0.0f;
+};
+
+//tempo by autocorrelation of the onset envelope, resampled to kEnvelopeRate. every envelope sample updates a
+//decaying autocorrelation at the lags between kMaxBpm and kMinBpm, the best lag (weighted towards 120bpm so
+//half and double tempo don't win on a tie) is the tempo. the beat phase is a phase locked loop running at that
+//tempo, pulled towards onsets that land close to where it expects a beat
+class TempoTracker
+{
+public:
+	static const uint32_t kEnvelopeRate = 100; //per second
+	static const uint32_t kMinBpm = 60;
+	static const uint32_t kMaxBpm = 200;
+	static const size_t kMinLag = 60 * kEnvelopeRate / kMaxBpm;
+	static const size_t kMaxLag = 60 * kEnvelopeRate / kMinBpm;
+	static const size_t kEnvelopeLength = 128; //ring, past kMaxLag
+	void Process(float novelty, bool onset, int64_t us, RhythmState& state);
+private:
+	void AddEnvelope(float value);
+	void Estimate(RhythmState& state);
+	float mEnvelope[kEnvelopeLength] = {};
+	uint64_t mSamples = 0;
+	float mAutocorrelation[kMaxLag + 1] = {};
+	float mEnergy = 0.0f; //the autocorrelation at lag 0
+	size_t mLag = 0; //the tempo's, 0 before there is one
+	int64_t mLastUs = 0;
+	double mClock = 0.0; //in envelope samples, the envelope gets filled up to here
+	float mPending = 0.0f; //strongest novelty since the last envelope sample
+	bool mStarted = false;
+};
+
+//runs both on every analyzed frame, O(bins) and no allocation. one thread only
+class BeatTracker
+{
+public:
+	const RhythmState& Process(const float* magnitudes, size_t bins, int64_t us);
+	const RhythmState& State() const { return mState; };
+private:
+	OnsetDetector mOnsets;
+	TempoTracker mTempo;
+	RhythmState mState;
+};
+
+#endif //!WINORB_BEAT_TRACKER_H
@@ -0,0 +1,484 @@
+#include "Bench.h"
+#include "ChartLevels.h"
+#include "Analyzer.h"
+#include "ThreadPool.h"
+#include "File.h"
+#include "SpectrumRecording.h"
+#include "PitchTracker.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <string>
+
+namespace
+{
+	//best of a few runs, the first one is usually paying for page faults
+	template<typename F>
+	double BestNsPerItem(size_t items, int iterations, F&& body)
+	{
+		double best = 1e30;
+		for (int run = 0; run < 5; ++run)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int it = 0; it < iterations; ++it)
+				body();
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			best = ns < best ? ns : best;
+		}
+		return best / ((double)items * iterations);
+	}
+
+	void BenchChartLevels(size_t count)
+	{
+		//magnitudes spread over the whole range the chart can show and then some, plus exact zeros
+		std::vector<float> magnitudes(count);
+		uint32_t seed = 12345;
+		for (size_t i = 0; i < count; ++i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			float exponent = -14.0f + 16.0f * ((seed >> 8) / (float)(1 << 24));
+			magnitudes[i] = (i % 97 == 0) ? 0.0f : powf(10.0f, exponent);
+		}
+
+		std::vector<float> reference(count);
+		std::vector<float> fast(count);
+		const int iterations = (int)(4000000 / count) + 1;
+		double libmns = BestNsPerItem(count, iterations, [&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				float level = ToChartLevel(magnitudes[i]);
+				reference[i] = level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+			}
+		});
+		double fastns = BestNsPerItem(count, iterations, [&]()
+		{
+			ToChartLevels(magnitudes.data(), fast.data(), count);
+		});
+
+		//in chart units (1 is the full 150dB range) and in dB, against the unclamped libm log
+		float maxerr = 0.0f;
+		float maxlog2err = 0.0f;
+		for (size_t i = 0; i < count; ++i)
+		{
+			maxerr = fmaxf(maxerr, fabsf(reference[i] - fast[i]));
+			if (magnitudes[i] > 0.0f)
+				maxlog2err = fmaxf(maxlog2err, fabsf(FastLog2(magnitudes[i]) - (float)log2((double)magnitudes[i])));
+		}
+		fprintf(stderr, "chart levels %6zu bins: libm %6.2f ns/bin, fast %6.2f ns/bin, %5.1fx, max err %.2e (%.2e dB), log2 err %.2e\n",
+			count, libmns, fastns, fastns > 0.0 ? libmns / fastns : 0.0, maxerr, maxerr * 150.0f, maxlog2err);
+	}
+
+	//the same stft as the scaling run, just on the default pool
+	std::vector<std::vector<float>> Stft(const WavData& audio, const AnalysisSettings& settings, size_t hop)
+	{
+		const size_t channel = audio.channels - 1;
+		const size_t frames = audio.FrameCount();
+		std::vector<std::vector<float>> rows(frames < settings.fftSize ? 0 : (frames - settings.fftSize) / hop + 1);
+		ThreadPool pool;
+		pool.ParallelFor(0, rows.size(), 16, [&](size_t first, size_t last)
+		{
+			complex_sample sample(settings.fftSize);
+			FrameArena arena;
+			for (size_t w = first; w < last; ++w)
+			{
+				for (size_t i = 0; i < settings.fftSize; ++i)
+					sample[i] = fcomplex(audio.samples[(w * hop + i) * audio.channels + channel], 0.0f);
+				AnalyzeSpectrum(sample, settings, rows[w], arena);
+				arena.NextFrame();
+			}
+		});
+		return rows;
+	}
+
+	//a whole 10 minute recording (the track over and over) on screen: every frame decoded against the pyramid's
+	//rows at a few window widths
+	void BenchPyramid(const std::vector<std::vector<float>>& rows, uint32_t sampleRate, uint32_t fftSize, size_t hop)
+	{
+		const char* path = "WinOrbBenchLong.wos";
+		const int64_t frameus = (int64_t)hop * 1000000 / sampleRate;
+		const size_t total = (size_t)(600 * 1000000 / frameus);
+		SpectrumRecorder recorder;
+		if (!recorder.Open(path))
+			return;
+		auto t0 = std::chrono::steady_clock::now();
+		for (size_t f = 0; f < total; ++f)
+		{
+			const std::vector<float>& row = rows[f % rows.size()];
+			recorder.Append(row.data(), (uint32_t)row.size(), sampleRate, fftSize, f * hop, t0 + std::chrono::microseconds(f * frameus));
+		}
+		recorder.Close();
+
+		SpectrumRecordingReader reader;
+		SpectrumPyramidReader pyramid;
+		if (!reader.Open(path) || !pyramid.Open((std::string(path) + ".pyr").c_str()))
+			return;
+		std::vector<RecordedFrame> frames;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t c = 0; c < reader.ChunkCount(); ++c)
+			reader.ReadChunk(c, frames);
+		double decodems = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		fprintf(stderr, "overview by decoding all %llu frames: %.2f ms\n", (unsigned long long)reader.FrameCount(), decodems);
+
+		std::vector<uint8_t> max;
+		std::vector<uint8_t> mean;
+		for (uint32_t pixels : { 256u, 1024u, 4096u })
+		{
+			uint64_t rowsread = 0;
+			start = std::chrono::steady_clock::now();
+			const int runs = 20;
+			for (int i = 0; i < runs; ++i)
+				pyramid.Fetch(0, reader.DurationUs(), pixels, max, mean, &rowsread);
+			double fetchms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+			fprintf(stderr, "overview off the pyramid at %4u px: %.3f ms, %llu rows read, %.1fx faster\n", pixels, fetchms,
+				(unsigned long long)rowsread, decodems / fetchms);
+		}
+		reader.Close();
+		pyramid.Close();
+		remove(path);
+		remove((std::string(path) + ".pyr").c_str());
+	}
+
+	//writes the track's stft as a recording at both bit depths: cpu per frame against the live frame rate, size
+	//against raw floats, then reads it back and seeks all over the place
+	void BenchRecording(const WavData& audio)
+	{
+		AnalysisSettings settings;
+		settings.window = WindowFunction::Hann;
+		const size_t hop = 512;
+		std::vector<std::vector<float>> rows = Stft(audio, settings, hop);
+		if (rows.empty())
+			return;
+		const char* path = "WinOrbBench.wos";
+		const int64_t frameus = (int64_t)hop * 1000000 / audio.sampleRate;
+		for (uint32_t bits : { 8u, 16u })
+		{
+			SpectrumRecorder recorder;
+			if (!recorder.Open(path, bits))
+				return;
+			auto t0 = std::chrono::steady_clock::now();
+			auto start = std::chrono::steady_clock::now();
+			for (size_t f = 0; f < rows.size(); ++f)
+				recorder.Append(rows[f].data(), (uint32_t)rows[f].size(), audio.sampleRate, (uint32_t)settings.fftSize, f * hop, t0 + std::chrono::microseconds(f * frameus));
+			recorder.Close();
+			double writeus = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rows.size();
+			double raw = (double)rows.size() * rows[0].size() * sizeof(float);
+
+			//random seeks, each one lands in some chunk and decodes it
+			SpectrumRecordingReader reader;
+			if (!reader.Open(path))
+				return;
+			const int seeks = 1000;
+			uint32_t seed = 12345;
+			float maxerr = 0.0f;
+			int misses = 0;
+			std::vector<float> levels(rows[0].size());
+			start = std::chrono::steady_clock::now();
+			for (int i = 0; i < seeks; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				size_t f = seed % rows.size();
+				RecordedFrame frame;
+				if (!reader.FrameAt((int64_t)f * frameus, frame) || frame.frame != f)
+				{
+					++misses;
+					continue;
+				}
+				ToChartLevels(rows[f].data(), levels.data(), levels.size());
+				for (size_t b = 0; b < levels.size(); ++b)
+					maxerr = std::max(maxerr, fabsf(levels[b] - frame.levels[b]));
+			}
+			double seekus = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / seeks;
+			reader.Close();
+
+			//the live loop analyzes about every 10ms
+			fprintf(stderr, "recording %2u bit: %6.1f us/frame (%.2f%% of a core at 100 frames/s), %6.1f bytes/frame, %5.1fx smaller than floats, "
+				"seek %6.1f us, max err %.1f dB, %s\n", bits, writeus, writeus / 100.0, recorder.BytesWritten() / (double)rows.size(),
+				raw / recorder.BytesWritten(), seekus, maxerr * 150.0f, misses == 0 ? "every seek hit" : "MISSED SEEKS");
+		}
+		remove(path);
+		remove((std::string(path) + ".pyr").c_str());
+		BenchPyramid(rows, audio.sampleRate, (uint32_t)settings.fftSize, hop);
+	}
+
+	//stereo, a few drifting tones plus noise, same every run
+	WavData GenerateTrack(float seconds)
+	{
+		WavData audio;
+		audio.sampleRate = 48000;
+		audio.channels = 2;
+		size_t frames = (size_t)(seconds * audio.sampleRate);
+		audio.samples.resize(frames * 2);
+		uint32_t seed = 12345;
+		for (size_t i = 0; i < frames; ++i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			float noise = (seed >> 8) / (float)(1 << 24) - 0.5f;
+			float t = i / (float)audio.sampleRate;
+			float val = 0.4f * sinf(6.2831853f * (110.0f + 20.0f * t) * t) + 0.2f * sinf(6.2831853f * 3520.0f * t) + 0.05f * noise;
+			audio.samples[i * 2] = val;
+			audio.samples[i * 2 + 1] = val;
+		}
+		return audio;
+	}
+
+	//the offline workload: a 2048 point hann stft over the whole track, hop 512, then the loudest level per bar
+	//over all of it as a task that depends on every chunk. 1 thread up to all of them, against the 1 thread run
+	void BenchStftScaling(const WavData& audio)
+	{
+		AnalysisSettings settings;
+		settings.window = WindowFunction::Hann;
+		const size_t hop = 512;
+		const size_t channel = audio.channels - 1;
+		const size_t frames = audio.FrameCount();
+		if (frames < settings.fftSize)
+			return;
+		const size_t windows = (frames - settings.fftSize) / hop + 1;
+		const size_t chunks = 64;
+		std::vector<std::vector<float>> rows(windows);
+		std::vector<float> loudest(settings.chartBins);
+
+		auto run = [&](ThreadPool& pool)
+		{
+			TaskGraph graph;
+			std::vector<TaskGraph::TaskId> parts;
+			for (size_t c = 0; c < chunks; ++c)
+			{
+				parts.push_back(graph.Add([&, c]()
+				{
+					complex_sample sample(settings.fftSize);
+					FrameArena arena;
+					for (size_t w = c * windows / chunks; w < (c + 1) * windows / chunks; ++w)
+					{
+						for (size_t i = 0; i < settings.fftSize; ++i)
+							sample[i] = fcomplex(audio.samples[(w * hop + i) * audio.channels + channel], 0.0f);
+						AnalyzeSpectrum(sample, settings, rows[w], arena);
+						arena.NextFrame();
+					}
+				}));
+			}
+			graph.Add([&]()
+			{
+				std::fill(loudest.begin(), loudest.end(), 0.0f);
+				for (const std::vector<float>& row : rows)
+				{
+					for (size_t i = 0; i < row.size(); ++i)
+						loudest[i] = std::max(loudest[i], row[i]);
+				}
+			}, parts);
+			graph.Run(pool);
+		};
+
+		std::vector<size_t> threadcounts;
+		const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t threads = 1; threads < hardware; threads *= 2)
+			threadcounts.push_back(threads);
+		threadcounts.push_back(hardware);
+
+		fprintf(stderr, "stft %zu windows of %zu (%.1fs of audio), %zu hardware threads\n", windows, settings.fftSize, frames / (double)audio.sampleRate, hardware);
+		double serial = 0.0;
+		std::vector<float> reference;
+		for (size_t threads : threadcounts)
+		{
+			ThreadPool pool(threads);
+			double best = 1e30;
+			for (int rep = 0; rep < 3; ++rep)
+			{
+				auto start = std::chrono::steady_clock::now();
+				run(pool);
+				best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			}
+			if (threads == 1)
+			{
+				serial = best;
+				reference = loudest;
+			}
+			double speedup = best > 0.0 ? serial / best : 0.0;
+			fprintf(stderr, "stft %2zu threads: %8.3fs, %5.2fx, %5.1f%% efficiency, %s\n", threads, best, speedup,
+				100.0 * speedup / threads, loudest == reference ? "same result" : "MISMATCH");
+		}
+	}
+
+	//one tone, the fundamental plus harmonics falling off as 1/k^rolloff (0 harmonics is a sine), vibrato of up to
+	//that many cents at 5Hz, and noise
+	void GenerateTone(std::vector<float>& out, float hz, unsigned harmonics, float rolloff, float vibrato, float noise, unsigned sampleRate, uint32_t seed)
+	{
+		const float twopi = 6.2831853f;
+		double phase = 0.0;
+		for (size_t i = 0; i < out.size(); ++i)
+		{
+			float t = i / (float)sampleRate;
+			phase += twopi * hz * exp2f(vibrato / 1200.0f * sinf(twopi * 5.0f * t)) / sampleRate;
+			float val = 0.0f;
+			for (unsigned k = 1; k <= harmonics + 1 && k * hz < 0.45f * sampleRate; ++k)
+				val += sinf((float)fmod(k * phase, (double)twopi)) / powf((float)k, rolloff);
+			seed = seed * 1664525u + 1013904223u;
+			out[i] = 0.3f * val + noise * ((seed >> 8) / (float)(1 << 24) - 0.5f);
+		}
+	}
+
+	//the pitch tracker has one stft hop to run in, at 48kHz 512 samples are 10.7ms. tones from E2 up to E6 with the
+	//error in cents against the frequency they were made at (the vibrato counts as error), pure noise that shouldn't come out as a note, and the
+	//fft autocorrelation against the O(n^2) loop it replaces. then the track, for vocals pass a recording of some
+	void BenchPitch(const WavData& audio)
+	{
+		const unsigned rate = 48000;
+		const size_t window = 2048;
+		const size_t hop = 512;
+		const double budgetus = 1e6 * hop / rate;
+		const float notes[] = { 82.41f, 110.0f, 146.83f, 196.0f, 261.63f, 329.63f, 440.0f, 659.26f, 987.77f, 1318.51f };
+		struct Voice { const char* name; unsigned harmonics; float rolloff; float vibrato; float noise; };
+		const Voice voices[] = { { "sine", 0, 1.0f, 0.0f, 0.0f }, { "sawtooth", 60, 1.0f, 0.0f, 0.0f }, { "voice-ish", 12, 1.5f, 20.0f, 0.05f },
+			{ "noisy", 8, 1.0f, 0.0f, 0.3f } };
+		PitchTracker tracker;
+		FrameArena arena;
+		complex_sample samples(window);
+		std::vector<float> tone(rate / 2);
+		for (const Voice& voice : voices)
+		{
+			size_t windows = 0;
+			size_t voiced = 0;
+			float worst = 0.0f;
+			double sum = 0.0;
+			for (float hz : notes)
+			{
+				GenerateTone(tone, hz, voice.harmonics, voice.rolloff, voice.vibrato, voice.noise, rate, 777u + (uint32_t)hz);
+				for (size_t at = 0; at + window <= tone.size(); at += hop)
+				{
+					for (size_t i = 0; i < window; ++i)
+						samples[i] = fcomplex(tone[at + i], 0.0f);
+					PitchEstimate estimate = tracker.Process(samples.data(), window, rate, arena);
+					arena.NextFrame();
+					++windows;
+					if (estimate.hz <= 0.0f)
+						continue;
+					++voiced;
+					float cents = fabsf(1200.0f * log2f(estimate.hz / hz));
+					worst = std::max(worst, cents);
+					sum += cents;
+				}
+			}
+			fprintf(stderr, "pitch %-10s %5.1f%% of %zu windows voiced, mean err %5.2f cents, max %7.2f cents\n", voice.name,
+				100.0 * voiced / windows, windows, voiced > 0 ? sum / voiced : 0.0, worst);
+		}
+
+		std::vector<float> noise(rate / 2);
+		uint32_t seed = 4242;
+		for (float& val : noise)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			val = 0.5f * ((seed >> 8) / (float)(1 << 24) - 0.5f);
+		}
+		size_t falsenotes = 0;
+		size_t noisewindows = 0;
+		for (size_t at = 0; at + window <= noise.size(); at += hop, ++noisewindows)
+		{
+			for (size_t i = 0; i < window; ++i)
+				samples[i] = fcomplex(noise[at + i], 0.0f);
+			falsenotes += tracker.Process(samples.data(), window, rate, arena).hz > 0.0f ? 1 : 0;
+			arena.NextFrame();
+		}
+
+		//the autocorrelation over the lags the tracker looks at, straight up and through FFT/IFFT
+		GenerateTone(tone, 220.0f, 12, 1.5f, 20.0f, 0.05f, rate, 99u);
+		const size_t maxlag = window / 2 + 1;
+		std::vector<float> direct(maxlag + 1);
+		double directns = BestNsPerItem(1, 20, [&]()
+		{
+			for (size_t lag = 0; lag <= maxlag; ++lag)
+			{
+				float r = 0.0f;
+				for (size_t i = 0; i + lag < window; ++i)
+					r += tone[i] * tone[i + lag];
+				direct[lag] = r;
+			}
+		});
+		complex_sample padded(2 * window);
+		double fftns = BestNsPerItem(1, 20, [&]()
+		{
+			std::fill(padded.begin(), padded.end(), fcomplex(0.0f, 0.0f));
+			for (size_t i = 0; i < window; ++i)
+				padded[i] = fcomplex(tone[i], 0.0f);
+			FFT(padded, arena);
+			for (fcomplex& val : padded)
+				val = fcomplex(std::norm(val), 0.0f);
+			IFFT(padded, arena);
+			arena.NextFrame();
+		});
+		float correlationerr = 0.0f;
+		for (size_t lag = 0; lag <= maxlag; ++lag)
+			correlationerr = std::max(correlationerr, fabsf(padded[lag].real() - direct[lag]) / direct[0]);
+		complex_sample roundtrip = IFFT(FFT(samples));
+		float roundtriperr = 0.0f;
+		for (size_t i = 0; i < window; ++i)
+			roundtriperr = std::max(roundtriperr, std::abs(roundtrip[i] - samples[i]));
+		for (size_t i = 0; i < window; ++i)
+			samples[i] = fcomplex(tone[i], 0.0f);
+		double trackns = BestNsPerItem(1, 50, [&]()
+		{
+			tracker.Process(samples.data(), window, rate, arena);
+			arena.NextFrame();
+		});
+		fprintf(stderr, "pitch noise: %zu of %zu windows called a note. autocorrelation: direct %7.1f us, fft %6.1f us, %5.1fx, max err %.2e, "
+			"ifft round trip err %.2e\n", falsenotes, noisewindows, directns / 1000.0, fftns / 1000.0, fftns > 0.0 ? directns / fftns : 0.0,
+			correlationerr, roundtriperr);
+		fprintf(stderr, "pitch %zu sample window: %6.1f us, %.2f%% of a %zu sample hop at 48kHz on one core\n", window, trackns / 1000.0,
+			100.0 * trackns / 1000.0 / budgetus, hop);
+
+		//the track at its own rate, no ground truth so just how much of it has a note and how often that jumps an
+		//octave or more between neighbouring windows
+		const size_t channel = audio.channels - 1;
+		const size_t frames = audio.FrameCount();
+		const size_t trackhop = std::max<size_t>(1, audio.sampleRate * hop / rate);
+		size_t trackwindows = 0;
+		size_t trackvoiced = 0;
+		size_t jumps = 0;
+		float last = 0.0f;
+		double slowest = 0.0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t at = 0; at + window <= frames; at += trackhop, ++trackwindows)
+		{
+			auto one = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < window; ++i)
+				samples[i] = fcomplex(audio.samples[(at + i) * audio.channels + channel], 0.0f);
+			PitchEstimate estimate = tracker.Process(samples.data(), window, audio.sampleRate, arena);
+			arena.NextFrame();
+			slowest = std::max(slowest, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - one).count());
+			if (estimate.hz > 0.0f)
+			{
+				++trackvoiced;
+				jumps += last > 0.0f && fabsf(log2f(estimate.hz / last)) >= 0.9f ? 1 : 0;
+			}
+			last = estimate.hz;
+		}
+		double trackus = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		if (trackwindows > 0)
+			fprintf(stderr, "pitch on the track: %zu windows, %5.1f%% voiced, %zu octave jumps, %6.1f us/window, slowest %6.1f us\n",
+				trackwindows, 100.0 * trackvoiced / trackwindows, jumps, trackus / trackwindows, slowest);
+	}
+}
+
+int RunBench(const char* wavpath)
+{
+	//the default bar count, the biggest fft's worth of bins, the most bars the overlay allows
+	const size_t counts[] = { 1024, 4096, 32768 };
+	for (size_t count : counts)
+		BenchChartLevels(count);
+
+	WavData audio;
+	if (wavpath != nullptr && !readwav(wavpath, audio))
+	{
+		fprintf(stderr, "couldn't read %s, only plain PCM/float wavs are supported\n", wavpath);
+		return 1;
+	}
+	if (wavpath == nullptr)
+		audio = GenerateTrack(30.0f);
+	BenchStftScaling(audio);
+	BenchRecording(audio);
+	BenchPitch(audio);
+	return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef WINORB_BENCH_H
+#define WINORB_BENCH_H
+
+//WinOrb.exe --bench [track.wav]
+//times the cpu side hot loops against their straightforward versions and prints the speedup and the error, no gpu needed
+//the stft scaling run and the pitch tracker go over the track when there is one (vocals, for the pitch), a generated one otherwise
+int RunBench(const char* wavpath);
+
+#endif //!WINORB_BENCH_H
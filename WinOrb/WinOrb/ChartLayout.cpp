@@ -0,0 +1,28 @@
+#include "ChartLayout.h"
+#include <math.h>
+
+void BuildChartLayout(uint32_t bins, uint32_t columns, std::vector<ChartBar>& bars)
+{
+	bars.clear();
+	if (bins == 0)
+		return;
+	columns = columns == 0 ? 1 : columns;
+
+	//same axis as chart.comp used to compute per bin, bin 0 sits on the left edge with bin 1
+	const float logbins = log2f((float)bins);
+	auto binx = [&](uint32_t bin) { return bin == 0 || logbins <= 0.0f ? 0.0f : log2f((float)bin) / logbins; };
+
+	uint32_t lastcolumn = UINT32_MAX;
+	for (uint32_t bin = 0; bin < bins; ++bin)
+	{
+		float x = binx(bin);
+		uint32_t column = (uint32_t)(x * columns);
+		if (!bars.empty() && column == lastcolumn)
+		{
+			bars.back().last = bin + 1;
+			continue;
+		}
+		bars.push_back({ bin, bin + 1, x, 0.0f });
+		lastcolumn = column;
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef WINORB_CHART_LAYOUT_H
+#define WINORB_CHART_LAYOUT_H
+
+#include <stdint.h>
+#include <vector>
+
+//one bar of the chart, covering the bins [first, last) that land in the same pixel column
+//matches BarRange in chart.comp
+struct ChartBar
+{
+	uint32_t first;
+	uint32_t last;
+	float x; //0 on the left edge of the chart, 1 on the right
+	float pad;
+};
+
+//the top of ChartLayout in chart.comp, the bars follow right after
+struct ChartLayoutHeader
+{
+	uint32_t bars;
+	uint32_t pad[3];
+};
+
+//groups the bins on the chart's log axis into at most one bar per pixel column, the low end still gets a bar
+//per bin since those are wider than a pixel. the bar count only depends on the width, not on the fft size
+void BuildChartLayout(uint32_t bins, uint32_t columns, std::vector<ChartBar>& bars);
+
+#endif //!WINORB_CHART_LAYOUT_H
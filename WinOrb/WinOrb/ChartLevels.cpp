@@ -0,0 +1,91 @@
+#include "ChartLevels.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WINORB_SSE2 1
+#endif
+
+namespace
+{
+	//level = (log2(magnitude) - log2(1e-11)) * 10 * log10(2) / 150
+	const float kLevelScale = 10.0f * 0.30102999f / 150.0f;
+	const float kLevelFloor = -36.541209f; //log2(1e-11)
+	const float kMinMagnitude = 1e-30f; //keeps zeros and denormals out of the exponent trick, they clamp to 0 anyway
+	const float kSqrt2 = 1.41421356f;
+	//2/ln(2) * (t + t^3/3 + t^5/5 + t^7/7), t = (m - 1) / (m + 1)
+	const float kC1 = 2.88539008f;
+	const float kC3 = 0.96179669f;
+	const float kC5 = 0.57707802f;
+	const float kC7 = 0.41219858f;
+}
+
+float ToChartLevel(float magnitude)
+{
+	const float dbform = 10 / log(10);
+	const float intensitycoeff = 1.0f * 10e-12;
+	return dbform * log(magnitude / intensitycoeff) / 150;
+}
+
+float FastLog2(float x)
+{
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int32_t exponent = (int32_t)(bits >> 23) - 127;
+	bits = (bits & 0x007FFFFF) | 0x3F800000;
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+	if (m > kSqrt2)
+	{
+		m *= 0.5f;
+		++exponent;
+	}
+	float t = (m - 1.0f) / (m + 1.0f);
+	float t2 = t * t;
+	return (float)exponent + t * (kC1 + t2 * (kC3 + t2 * (kC5 + t2 * kC7)));
+}
+
+void ToChartLevels(const float* magnitudes, float* levels, size_t count)
+{
+	size_t i = 0;
+#ifdef WINORB_SSE2
+	const __m128 minmagnitude = _mm_set1_ps(kMinMagnitude);
+	const __m128 sqrt2 = _mm_set1_ps(kSqrt2);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i mantissamask = _mm_set1_epi32(0x007FFFFF);
+	const __m128i exponentone = _mm_set1_epi32(0x3F800000);
+	const __m128i bias = _mm_set1_epi32(127);
+	for (; i + 4 <= count; i += 4)
+	{
+		//max() returns the second operand for NaN, so those end up at the floor too
+		__m128 x = _mm_max_ps(_mm_loadu_ps(magnitudes + i), minmagnitude);
+		__m128i bits = _mm_castps_si128(x);
+		__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), bias);
+		__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissamask), exponentone));
+
+		//fold [sqrt(2), 2) down to [sqrt(0.5), 1), the mask is -1 where it applies
+		__m128 fold = _mm_cmpgt_ps(m, sqrt2);
+		m = _mm_or_ps(_mm_and_ps(fold, _mm_mul_ps(m, half)), _mm_andnot_ps(fold, m));
+		exponent = _mm_sub_epi32(exponent, _mm_castps_si128(fold));
+
+		__m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 poly = _mm_add_ps(_mm_set1_ps(kC5), _mm_mul_ps(t2, _mm_set1_ps(kC7)));
+		poly = _mm_add_ps(_mm_set1_ps(kC3), _mm_mul_ps(t2, poly));
+		poly = _mm_add_ps(_mm_set1_ps(kC1), _mm_mul_ps(t2, poly));
+		__m128 log2x = _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(t, poly));
+
+		__m128 level = _mm_mul_ps(_mm_sub_ps(log2x, _mm_set1_ps(kLevelFloor)), _mm_set1_ps(kLevelScale));
+		_mm_storeu_ps(levels + i, _mm_min_ps(_mm_max_ps(level, zero), one));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		float x = magnitudes[i] > kMinMagnitude ? magnitudes[i] : kMinMagnitude;
+		float level = (FastLog2(x) - kLevelFloor) * kLevelScale;
+		levels[i] = level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef WINORB_CHART_LEVELS_H
+#define WINORB_CHART_LEVELS_H
+
+#include <stddef.h>
+
+//dB scale the bars and the waterfall share, 0 sits on the baseline and 1 at the top of the chart
+//libm version, the reference for the fast one (and what toLevel in the shaders does)
+float ToChartLevel(float magnitude);
+
+//log2 off the float's exponent plus an atanh series on the mantissa folded into [sqrt(0.5), sqrt(2)),
+//the first dropped term bounds the error at about 5e-8, so it's as good as logf in float
+float FastLog2(float x);
+
+//ToChartLevel through FastLog2 over a whole array, 4 at a time with SSE2, clamped to [0, 1]
+//levels can be the same array as magnitudes
+void ToChartLevels(const float* magnitudes, float* levels, size_t count);
+
+#endif //!WINORB_CHART_LEVELS_H
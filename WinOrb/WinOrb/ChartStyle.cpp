@@ -0,0 +1,31 @@
+#include "ChartStyle.h"
+
+const char* ChartPresetName(ChartPreset preset)
+{
+	switch (preset)
+	{
+	case ChartPreset::Raw: return "raw";
+	case ChartPreset::Smooth: return "smooth";
+	case ChartPreset::Normalized: return "normalized";
+	default: return "?";
+	}
+}
+
+ChartStyle MakeChartStyle(ChartPreset preset)
+{
+	ChartStyle style;
+	switch (preset)
+	{
+	case ChartPreset::Raw:
+		style.attack = 1.0f;
+		style.release = 1.0f;
+		style.showPeaks = 0;
+		break;
+	case ChartPreset::Normalized:
+		style.normalize = 1;
+		break;
+	default:
+		break;
+	}
+	return style;
+}
@@ -0,0 +1,30 @@
+#ifndef WINORB_CHART_STYLE_H
+#define WINORB_CHART_STYLE_H
+
+#include <stdint.h>
+
+//knobs for the chart compute pass, everything is per frame
+//the layout matches the top of ChartInput in chart.comp, so keep them in sync
+struct ChartStyle
+{
+	float attack = 0.6f; //how much of a rise gets through each frame, 1 is instant
+	float release = 0.15f; //same for falling
+	float peakHoldFrames = 30.0f;
+	float peakDecay = 0.01f; //level the peak loses per frame once the hold runs out
+	float maxDecay = 0.995f; //the running max shrinks by this much per frame
+	uint32_t normalize = 0; //scale by the running max instead of the fixed dB range
+	uint32_t showPeaks = 1;
+};
+
+enum class ChartPreset
+{
+	Raw, //what the cpu path used to draw, no smoothing at all
+	Smooth,
+	Normalized,
+	Count
+};
+
+const char* ChartPresetName(ChartPreset preset);
+ChartStyle MakeChartStyle(ChartPreset preset);
+
+#endif //!WINORB_CHART_STYLE_H
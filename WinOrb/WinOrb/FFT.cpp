@@ -1,4 +1,5 @@
 #include "FFT.h"
+#include "Trace.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <corecrt.h>
@@ -7,7 +8,6 @@
 namespace 
 {
 	constexpr float tau = 2 * M_PI;
-	constexpr fcomplex k_i(0.0f, 1.0f);//imaginary number sqrt(-1);
 }
 
 bool is_power_of_two(const size_t& n)
@@ -15,85 +15,108 @@ bool is_power_of_two(const size_t& n)
 	return(n & (n - 1)) == 0;
 }
 
-void FFT_Helper(complex_sample& sample)
+//twiddles holds w^k for the full size, a level of size n needs every stride'th one of them
+void FFT_Helper(fcomplex* sample, unsigned n, const fcomplex* twiddles, unsigned stride, FrameArena& arena)
 {
-	if (sample.size() <= 1)
+	if (n <= 1)
 	{
 		return;
 	}
-	complex_sample even;
-	complex_sample odd;
-	for (unsigned i = 0; i < sample.size(); i += 2)//split into odd/even
+	//both halves only live until they're combined back, the deeper levels reuse the same arena space
+	size_t mark = arena.Mark();
+	const unsigned n_2 = n / 2;
+	fcomplex* even = arena.Allocate<fcomplex>(n_2);
+	fcomplex* odd = arena.Allocate<fcomplex>(n_2);
+	for (unsigned i = 0; i < n_2; ++i)//split into odd/even
 	{
-		even.push_back(sample[i]);
-		odd.push_back(sample[i + 1]);
+		even[i] = sample[2 * i];
+		odd[i] = sample[2 * i + 1];
 	}
 
-	FFT_Helper(even);//recursion step
-	FFT_Helper(odd);
-
+	FFT_Helper(even, n_2, twiddles, stride * 2, arena);//recursion step
+	FFT_Helper(odd, n_2, twiddles, stride * 2, arena);
 
-	const unsigned n = sample.size();
-	const unsigned n_2 = n / 2;
-	fcomplex w = std::exp(tau * k_i/(float)n); //e^(2*pi*i/n)
 	//combine back together
 	for (unsigned j = 0; j < n_2; ++j)
 	{
-		sample[j] = even[j] + ((fcomplex)std::pow(w, j) * odd[j]);
-		sample[j + n_2] = even[j] - ((fcomplex)std::pow(w, j) * odd[j]);
+		fcomplex t = twiddles[j * stride] * odd[j];
+		sample[j] = even[j] + t;
+		sample[j + n_2] = even[j] - t;
 	}
-}
-complex_sample FFT(const complex_sample& sample)
-{
-	size_t n = sample.size();
-	assert(is_power_of_two(n));
-
-	complex_sample transformed = sample;
-	FFT_Helper(transformed);
-	return transformed;
+	arena.Rewind(mark);
 }
 
-void IFFT_Helper(complex_sample& sample)
+//sign 1 is the forward transform (e^(2*pi*i/n)), -1 the inverse without the 1/n
+void FFT_Helper(fcomplex* sample, unsigned n, float sign, FrameArena& arena)
 {
-	if (sample.size() <= 1)
+	if (n <= 1)
 	{
 		return;
 	}
-	complex_sample even;
-	complex_sample odd;
-	for (unsigned i = 0; i < sample.size(); i += 2)//split into odd/even
+	//one table per transform instead of a pow per butterfly, in double so the big sizes don't drift
+	size_t mark = arena.Mark();
+	const unsigned n_2 = n / 2;
+	fcomplex* twiddles = arena.Allocate<fcomplex>(n_2);
+	for (unsigned k = 0; k < n_2; ++k)
 	{
-		even.push_back(sample[i]);
-		odd.push_back(sample[i + 1]);
+		double angle = sign * 2.0 * M_PI * k / n;
+		twiddles[k] = fcomplex((float)cos(angle), (float)sin(angle));
 	}
+	FFT_Helper(sample, n, twiddles, 1, arena);
+	arena.Rewind(mark);
+}
 
-	FFT_Helper(even);//recursion step
-	FFT_Helper(odd);
-
-	const unsigned n = sample.size();
-	const unsigned n_2 = n / 2;
-	fcomplex w = std::exp(-tau * k_i / (float)n); //e^(2*pi*i/n)
-	//combine back together
-	for (unsigned i = 0; i < n_2; ++i)
+//for the versions that don't get an arena handed in. nothing from one call outlives it, so every call can start a
+//new frame, after the first few at a size the slab fits it and the heap stays out of it
+namespace
+{
+	FrameArena& ScratchArena()
 	{
-		sample[i] = even[i] + ((fcomplex)std::pow(w, i) * odd[i]);
-		sample[i + n_2] = even[i] - ((fcomplex)std::pow(w, i) * odd[i]);
+		thread_local FrameArena arena(64 << 10);
+		arena.NextFrame();
+		return arena;
 	}
 }
 
-complex_sample IFFT(const complex_sample& sample)
+void FFT_Helper(complex_sample& sample, float sign)
+{
+	assert(is_power_of_two(sample.size()));
+	FFT_Helper(sample.data(), (unsigned)sample.size(), sign, ScratchArena());
+}
+
+complex_sample FFT(const complex_sample& sample)
+{
+	complex_sample transformed = sample;
+	FFT_Helper(transformed, 1.0f);
+	return transformed;
+}
+
+void FFT(complex_sample& sample, FrameArena& arena)
 {
+	TRACE_SCOPE("FFT");
 	size_t n = sample.size();
 	assert(is_power_of_two(n));
+	FFT_Helper(sample.data(), (unsigned)n, 1.0f, arena);
+}
 
+complex_sample IFFT(const complex_sample& sample)
+{
 	complex_sample inverted = sample;
-	IFFT_Helper(inverted);
+	IFFT(inverted, ScratchArena());
+	return inverted;
+}
 
-	for (fcomplex& val : inverted)
+void IFFT(complex_sample& sample, FrameArena& arena)
+{
+	TRACE_SCOPE("IFFT");
+	size_t n = sample.size();
+	assert(is_power_of_two(n));
+	FFT_Helper(sample.data(), (unsigned)n, -1.0f, arena);
+	const float scale = 1.0f / n;
+	for (fcomplex& val : sample)
 	{
-		val /= n;
+		val *= scale;
 	}
-	return inverted;
 }
 
 std::vector<float> ToMagnitude(complex_sample sample)
@@ -105,3 +128,38 @@ std::vector<float> ToMagnitude(complex_sample sample)
 	}
 	return retval;
 }
+
+
+const char* WindowFunctionName(WindowFunction window)
+{
+	switch (window)
+	{
+	case WindowFunction::Rectangular: return "rectangular";
+	case WindowFunction::Hann: return "hann";
+	case WindowFunction::Hamming: return "hamming";
+	case WindowFunction::Blackman: return "blackman";
+	default: return "?";
+	}
+}
+
+void ApplyWindow(complex_sample& sample, WindowFunction window)
+{
+	const size_t n = sample.size();
+	if (window == WindowFunction::Rectangular || n < 2)
+		return;
+
+	const float step = tau / (float)(n - 1);
+	for (size_t i = 0; i < n; ++i)
+	{
+		float phase = step * i;
+		float w = 1.0f;
+		switch (window)
+		{
+		case WindowFunction::Hann: w = 0.5f - 0.5f * cosf(phase); break;
+		case WindowFunction::Hamming: w = 0.54f - 0.46f * cosf(phase); break;
+		case WindowFunction::Blackman: w = 0.42f - 0.5f * cosf(phase) + 0.08f * cosf(2.0f * phase); break;
+		default: break;
+		}
+		sample[i] *= w;
+	}
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define FFT_H
 
 //SUMMONING THE MAFFS GODS
+#include "FrameArena.h"
 #include <complex>
 #include <vector>
 
@@ -9,8 +10,23 @@ typedef std::complex<float> fcomplex;
 typedef std::vector<fcomplex> complex_sample;
 
 complex_sample FFT(const complex_sample& sample);
+//in place, the recursion's scratch comes out of the arena and goes back as soon as each level is combined
+void FFT(complex_sample& sample, FrameArena& arena);
+//the inverse of FFT, IFFT(FFT(x)) is x again
 complex_sample IFFT(const complex_sample& sample);
+void IFFT(complex_sample& sample, FrameArena& arena);
 std::vector<float> ToMagnitude(complex_sample sample);//convert frequency domain to magnitude chart, lossy
 
+enum class WindowFunction
+{
+	Rectangular, //aka no window, what the orb always did
+	Hann,
+	Hamming,
+	Blackman,
+	Count
+};
+const char* WindowFunctionName(WindowFunction window);
+void ApplyWindow(complex_sample& sample, WindowFunction window);
+
 
 #endif //!FFT_H
\ No newline at end of file
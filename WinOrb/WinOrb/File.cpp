@@ -1,5 +1,7 @@
 #include "File.h"
 #include <fstream>
+#include <string.h>
+#include <windows.h>
 
 std::vector<char> readfile(const std::string& fname)
 {
@@ -13,4 +15,150 @@ std::vector<char> readfile(const std::string& fname)
 	file.close();
 
 	return buffer;
-}
\ No newline at end of file
+}
+
+bool tryreadfile(const std::string& fname, std::vector<char>& buffer)
+{
+	std::ifstream file(fname, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return false;
+	size_t fsize = file.tellg();
+
+	buffer.resize(fsize);
+	file.seekg(0);
+	file.read(buffer.data(), fsize);
+	file.close();
+
+	return true;
+}
+
+namespace
+{
+	template<typename T>
+	T readle(const char* p)
+	{
+		T val;
+		memcpy(&val, p, sizeof(T));
+		return val;
+	}
+}
+
+bool readwav(const std::string& fname, WavData& wav)
+{
+	std::vector<char> file;
+	if (!tryreadfile(fname, file) || file.size() < 12)
+		return false;
+	if (memcmp(&file[0], "RIFF", 4) != 0 || memcmp(&file[8], "WAVE", 4) != 0)
+		return false;
+
+	uint16_t format = 0;
+	uint16_t bits = 0;
+	const char* data = nullptr;
+	size_t datasize = 0;
+
+	//walk the chunks, we only care about fmt and data
+	size_t pos = 12;
+	while (pos + 8 <= file.size())
+	{
+		const char* chunk = &file[pos];
+		size_t chunksize = readle<uint32_t>(chunk + 4);
+		size_t available = file.size() - (pos + 8);
+		if (chunksize > available)
+			chunksize = available; //truncated files are common enough, take what's there
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunksize >= 16)
+		{
+			format = readle<uint16_t>(chunk + 8);
+			wav.channels = readle<uint16_t>(chunk + 10);
+			wav.sampleRate = readle<uint32_t>(chunk + 12);
+			bits = readle<uint16_t>(chunk + 22);
+			if (format == 0xFFFE && chunksize >= 26) //WAVE_FORMAT_EXTENSIBLE, the real format is the start of the subformat guid
+				format = readle<uint16_t>(chunk + 32);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			data = chunk + 8;
+			datasize = chunksize;
+		}
+		pos += 8 + chunksize + (chunksize & 1);
+	}
+
+	if (data == nullptr || wav.channels == 0 || wav.sampleRate == 0)
+		return false;
+
+	size_t bytespersample = bits / 8;
+	if (bytespersample == 0)
+		return false;
+	size_t count = datasize / bytespersample;
+	count -= count % wav.channels;
+	wav.samples.resize(count);
+
+	if (format == 3 && bits == 32) //IEEE float
+	{
+		memcpy(wav.samples.data(), data, count * sizeof(float));
+	}
+	else if (format == 1 && bits == 16)
+	{
+		for (size_t i = 0; i < count; ++i)
+			wav.samples[i] = readle<int16_t>(data + i * 2) / 32768.0f;
+	}
+	else if (format == 1 && bits == 24)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const unsigned char* p = (const unsigned char*)data + i * 3;
+			int32_t val = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+			wav.samples[i] = val / 8388608.0f;
+		}
+	}
+	else if (format == 1 && bits == 32)
+	{
+		for (size_t i = 0; i < count; ++i)
+			wav.samples[i] = readle<int32_t>(data + i * 4) / 2147483648.0f;
+	}
+	else
+	{
+		wav.samples.clear();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	mFile = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	mSize = (uint64_t)size.QuadPart;
+	mMapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mMapping != NULL)
+		mData = (const uint8_t*)MapViewOfFile((HANDLE)mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle((HANDLE)mMapping);
+	if (mFile != nullptr)
+		CloseHandle((HANDLE)mFile);
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = nullptr;
+	mSize = 0;
+}
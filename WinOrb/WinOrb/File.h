@@ -4,8 +4,37 @@
 #include <vector>
 #include <assert.h>
 #include <string>
+#include <stdint.h>
 
 std::vector<char> readfile(const std::string& fname);
+bool tryreadfile(const std::string& fname, std::vector<char>& buffer); //same as readfile but doesn't blow up on a missing file
+
+//interleaved samples straight out of a .wav, converted to float in [-1, 1]
+struct WavData
+{
+	unsigned sampleRate = 0;
+	unsigned channels = 0;
+	std::vector<float> samples;
+	size_t FrameCount() const { return channels ? samples.size() / channels : 0; };
+};
+//handles 16/24/32 bit PCM and 32 bit float, returns false on anything else
+bool readwav(const std::string& fname, WavData& wav);
+
+//a whole file mapped read only, for the recording readers
+class MappedFile
+{
+public:
+	~MappedFile() { Close(); };
+	bool Open(const char* path);
+	void Close();
+	const uint8_t* Data() const { return mData; };
+	uint64_t Size() const { return mSize; };
+private:
+	void* mFile = nullptr; //HANDLE
+	void* mMapping = nullptr; //HANDLE
+	const uint8_t* mData = nullptr;
+	uint64_t mSize = 0;
+};
 
 
 
@@ -0,0 +1,147 @@
+#include "FrameArena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+#include <algorithm>
+
+FrameArena::FrameArena(size_t bytes)
+{
+	for (Slab& slab : mSlabs)
+	{
+		slab.memory = (uint8_t*)::operator new(bytes);
+		slab.size = bytes;
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for (Slab& slab : mSlabs)
+	{
+		Release(slab);
+		::operator delete(slab.memory);
+	}
+}
+
+void FrameArena::Release(Slab& slab)
+{
+	for (void* block : slab.overflow)
+		::operator delete(block);
+	slab.overflow.clear();
+	slab.overflowBytes = 0;
+	slab.used = 0;
+}
+
+void FrameArena::NextFrame()
+{
+	mCurrent = (mCurrent + 1) % kFramesInFlight;
+	Slab& slab = mSlabs[mCurrent];
+	//whatever spilled over last time this slab was used, it gets room for all of it now
+	size_t needed = slab.used + slab.overflowBytes;
+	Release(slab);
+	if (needed > slab.size)
+	{
+		::operator delete(slab.memory);
+		slab.size = needed + needed / 4;
+		slab.memory = (uint8_t*)::operator new(slab.size);
+	}
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t align)
+{
+	Slab& slab = mSlabs[mCurrent];
+	size_t at = (slab.used + align - 1) & ~(align - 1);
+	if (at + bytes <= slab.size)
+	{
+		slab.used = at + bytes;
+		mHighWater = std::max(mHighWater, slab.used + slab.overflowBytes);
+		return slab.memory + at;
+	}
+	//doesn't fit, the heap covers it until the next reset of this slab grows it
+	void* block = ::operator new(std::max(bytes, (size_t)1));
+	slab.overflow.push_back(block);
+	slab.overflowBytes += bytes + align;
+	mHighWater = std::max(mHighWater, slab.used + slab.overflowBytes);
+	++mOverflows;
+	return block;
+}
+
+void FrameArena::Rewind(size_t mark)
+{
+	Slab& slab = mSlabs[mCurrent];
+	slab.used = std::min(slab.used, mark);
+}
+
+#ifdef _DEBUG
+
+namespace
+{
+	const uint64_t kWarmupFrames = 60; //buffers are still finding their size
+	const uint64_t kReportedFrames = 10;
+	thread_local uint64_t tHeapAllocations = 0;
+	thread_local uint32_t tChecking = 0;
+	thread_local uint64_t tCheckedFrames = 0;
+	std::atomic<uint64_t> gFlaggedFrames(0);
+}
+
+//the replaceable global ones, the array and nothrow versions all end up here
+void* operator new(size_t size)
+{
+	if (tChecking > 0)
+		++tHeapAllocations;
+	void* block = malloc(size != 0 ? size : 1);
+	if (block == nullptr)
+		throw std::bad_alloc();
+	return block;
+}
+
+void operator delete(void* block) noexcept
+{
+	free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+	free(block);
+}
+
+FrameHeapCheck::FrameHeapCheck(const char* loop) : mLoop(loop), mStart(tHeapAllocations), mOuter(tChecking == 0)
+{
+	++tChecking;
+}
+
+FrameHeapCheck::~FrameHeapCheck()
+{
+	--tChecking;
+	if (!mOuter || ++tCheckedFrames <= kWarmupFrames)
+		return;
+	uint64_t allocations = tHeapAllocations - mStart;
+	if (allocations == 0)
+		return;
+	uint64_t flagged = gFlaggedFrames.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (flagged <= kReportedFrames)
+		fprintf(stderr, "%s frame %llu allocated on the heap %llu times%s\n", mLoop, (unsigned long long)tCheckedFrames,
+			(unsigned long long)allocations, flagged == kReportedFrames ? ", not reporting any more" : "");
+}
+
+uint64_t FrameHeapCheck::FlaggedFrames()
+{
+	return gFlaggedFrames.load(std::memory_order_relaxed);
+}
+
+#else
+
+FrameHeapCheck::FrameHeapCheck(const char*)
+{
+}
+
+FrameHeapCheck::~FrameHeapCheck()
+{
+}
+
+uint64_t FrameHeapCheck::FlaggedFrames()
+{
+	return 0;
+}
+
+#endif //_DEBUG
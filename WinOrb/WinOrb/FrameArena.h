@@ -0,0 +1,88 @@
+#ifndef WINORB_FRAME_ARENA_H
+#define WINORB_FRAME_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//bump allocator for the scratch one frame needs and throws away. NextFrame hands back everything from two frames
+//ago at once, so whatever the last frame allocated is still good while the next one gets built (a frame in flight).
+//Mark/Rewind give back the tail early, for scratch that comes and goes in order like the fft's recursion
+//
+//a frame that needs more than the slab gets the rest from the heap and the slab grows to fit at the next reset,
+//after a couple of frames nothing touches the heap anymore. one thread only
+class FrameArena
+{
+public:
+	static const size_t kFramesInFlight = 2;
+	explicit FrameArena(size_t bytes = 1 << 20);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void NextFrame();
+	void* Allocate(size_t bytes, size_t align = alignof(max_align_t));
+	template<typename T>
+	T* Allocate(size_t count) { return (T*)Allocate(count * sizeof(T), alignof(T)); };
+	size_t Mark() const { return mSlabs[mCurrent].used; };
+	void Rewind(size_t mark);
+
+	size_t HighWater() const { return mHighWater; }; //most any one frame used, heap overflow included
+	uint64_t Overflows() const { return mOverflows; }; //allocations that didn't fit in the slab
+private:
+	struct Slab
+	{
+		uint8_t* memory = nullptr;
+		size_t size = 0;
+		size_t used = 0;
+		size_t overflowBytes = 0;
+		std::vector<void*> overflow;
+	};
+	void Release(Slab& slab);
+	Slab mSlabs[kFramesInFlight];
+	size_t mCurrent = 0;
+	size_t mHighWater = 0;
+	uint64_t mOverflows = 0;
+};
+
+//for std containers that only live for a frame, deallocate does nothing, the arena takes it all back at once
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	ArenaAllocator(FrameArena& arena) : mArena(&arena) {};
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.Arena()) {};
+	T* allocate(size_t count) { return mArena->Allocate<T>(count); };
+	void deallocate(T*, size_t) {};
+	FrameArena* Arena() const { return mArena; };
+private:
+	FrameArena* mArena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.Arena() == b.Arena(); }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.Arena() != b.Arena(); }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//debug builds count every operator new on a thread while one of these is alive, anything in a frame loop that
+//should have come from an arena (or a buffer kept around) instead. the first few offending frames go to stderr
+class FrameHeapCheck
+{
+public:
+	explicit FrameHeapCheck(const char* loop);
+	~FrameHeapCheck();
+	static uint64_t FlaggedFrames(); //frames that allocated anything, 0 in release builds
+private:
+#ifdef _DEBUG
+	const char* mLoop;
+	uint64_t mStart;
+	bool mOuter;
+#endif
+};
+
+#endif //!WINORB_FRAME_ARENA_H
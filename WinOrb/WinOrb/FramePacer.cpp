@@ -0,0 +1,139 @@
+#include "FramePacer.h"
+#include <windows.h>
+#include <thread>
+#include <algorithm>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002 //win10 1803+, older sdks don't have it
+#endif
+
+namespace
+{
+	//the os timer can overshoot by about this much, the rest gets spun off
+	const std::chrono::microseconds kHighResSpin(500);
+	const std::chrono::microseconds kLowResSpin(2000);
+	//slack on top of the predicted work for latency optimized, covers the odd slow frame
+	const double kLatencyMargin = 0.002;
+	//a present that blocked at least this long was waiting on vsync
+	const float kVsyncBlockMs = 1.0f;
+}
+
+const char* PacingModeName(PacingMode mode)
+{
+	switch (mode)
+	{
+	case PacingMode::Vsync: return "vsync only";
+	case PacingMode::TargetRate: return "target rate";
+	case PacingMode::LatencyOptimized: return "latency optimized";
+	case PacingMode::PowerSaver: return "power saver";
+	default: return "?";
+	}
+}
+
+PreciseTimer::PreciseTimer()
+{
+	mTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	mHighRes = mTimer != NULL;
+	if (mTimer == NULL)
+	{
+		mTimer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+	}
+}
+
+PreciseTimer::~PreciseTimer()
+{
+	if (mTimer != NULL)
+	{
+		CloseHandle((HANDLE)mTimer);
+	}
+}
+
+void PreciseTimer::SleepUntil(std::chrono::steady_clock::time_point target, bool spin)
+{
+	auto spinmargin = spin ? (mHighRes ? kHighResSpin : kLowResSpin) : std::chrono::microseconds(0);
+	auto coarse = target - spinmargin;
+	auto now = std::chrono::steady_clock::now();
+	if (mTimer != NULL && coarse > now)
+	{
+		//relative due time in 100ns ticks, negative means relative
+		LARGE_INTEGER due;
+		due.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(coarse - now).count() / 100);
+		if (SetWaitableTimer((HANDLE)mTimer, &due, 0, NULL, NULL, FALSE))
+		{
+			WaitForSingleObject((HANDLE)mTimer, INFINITE);
+		}
+	}
+	while (spin && std::chrono::steady_clock::now() < target)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void FramePacer::SetRefreshRate(float hz)
+{
+	mRefreshRate = hz > 0.0f ? hz : 60.0f;
+}
+
+double FramePacer::Period() const
+{
+	switch (mSettings.mode)
+	{
+	case PacingMode::TargetRate: return 1.0 / std::max(mSettings.targetRate, 1.0f);
+	case PacingMode::PowerSaver: return 2.0 / mRefreshRate;
+	default: return 1.0 / mRefreshRate;
+	}
+}
+
+float FramePacer::WaitForFrame()
+{
+	TRACE_SCOPE("pacing");
+	auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(Period()));
+	auto now = clock::now();
+	mDeadline += period;
+	if (mDeadline < now)
+	{
+		//fell behind (or just started), don't try to catch up with a burst of frames
+		mDeadline = now + period;
+	}
+
+	clock::time_point wake = now;
+	switch (mSettings.mode)
+	{
+	case PacingMode::TargetRate:
+	case PacingMode::PowerSaver:
+		wake = mDeadline - period;
+		break;
+	case PacingMode::LatencyOptimized:
+	{
+		//p99 so one fast frame doesn't get the next one started too late
+		double predicted = mWork.Count() > 0 ? mWork.P99() / 1000.0 : Period() * 0.5;
+		wake = mDeadline - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(predicted + kLatencyMargin));
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (wake > now)
+	{
+		mTimer.SleepUntil(wake, mSettings.mode != PacingMode::PowerSaver);
+	}
+	mWorkStart = clock::now();
+	return std::chrono::duration<float, std::milli>(mWorkStart - now).count();
+}
+
+void FramePacer::EndFrame(float presentms)
+{
+	auto end = clock::now();
+	float workms = std::chrono::duration<float, std::milli>(end - mWorkStart).count() - presentms;
+	mWork.Add(std::max(workms, 0.0f));
+	++mFrames;
+	if (end > mDeadline)
+	{
+		++mMissed;
+	}
+	if (presentms >= kVsyncBlockMs && mSettings.mode != PacingMode::TargetRate)
+	{
+		mDeadline = end;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef WINORB_FRAME_PACER_H
+#define WINORB_FRAME_PACER_H
+
+#include "Profiler.h"
+#include <stdint.h>
+#include <chrono>
+
+enum class PacingMode
+{
+	Vsync, //never sleeps, the present (or nothing, with mailbox) sets the pace
+	TargetRate, //frames start targetRate times a second
+	LatencyOptimized, //one frame per refresh, started as late as the measured work time allows
+	PowerSaver, //every other refresh, the whole wait on the os timer without spinning
+	Count
+};
+
+const char* PacingModeName(PacingMode mode);
+
+//tweakable live from the overlay
+struct PacingSettings
+{
+	PacingMode mode = PacingMode::LatencyOptimized;
+	float targetRate = 60.0f; //only for TargetRate
+};
+
+//high resolution waitable timer when the os has one (win10 1803+), a plain one otherwise. either can
+//overshoot a bit, so the end of the wait can be spun off
+class PreciseTimer
+{
+public:
+	PreciseTimer();
+	~PreciseTimer();
+	void SleepUntil(std::chrono::steady_clock::time_point target, bool spin);
+private:
+	void* mTimer = nullptr; //HANDLE
+	bool mHighRes = false;
+};
+
+//replaces a flat Sleep(16) in front of every frame: keeps a grid of deadlines one period apart, measures how
+//long the work takes and only sleeps whatever is left, on a high resolution timer plus a short spin at the end
+class FramePacer
+{
+public:
+	void SetSettings(const PacingSettings& settings) { mSettings = settings; };
+	void SetRefreshRate(float hz); //of the monitor, the deadline grid when not running at a target rate
+	//blocks until the next frame's work should start, returns how long it slept in ms
+	float WaitForFrame();
+	//right after the frame got presented, presentms is however long this frame's present blocked (0 without one),
+	//which isn't work. a present that blocked means vsync just happened, so the grid snaps to it
+	void EndFrame(float presentms);
+	uint64_t Frames() const { return mFrames; };
+	uint64_t MissedDeadlines() const { return mMissed; };
+	const RollingStats& WorkTime() const { return mWork; };
+private:
+	typedef std::chrono::steady_clock clock;
+	double Period() const; //seconds
+
+	PacingSettings mSettings;
+	float mRefreshRate = 60.0f;
+	clock::time_point mDeadline; //when the current frame should be presented by
+	clock::time_point mWorkStart;
+	RollingStats mWork;
+	uint64_t mFrames = 0;
+	uint64_t mMissed = 0;
+	PreciseTimer mTimer;
+};
+
+#endif //!WINORB_FRAME_PACER_H
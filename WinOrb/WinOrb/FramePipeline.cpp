@@ -0,0 +1,269 @@
+#include "FramePipeline.h"
+#include "FramePacer.h"
+#include "WASAPILoopbackCapture.h"
+#include "Trace.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	typedef std::chrono::steady_clock clock;
+	//wasapi hands out 10ms packets in shared mode, polling a bit faster than that keeps the added latency small
+	const std::chrono::milliseconds kCapturePoll(2);
+	//once idle the wasapi buffer (a second long) has plenty of room, no need to poll that often
+	const std::chrono::milliseconds kIdleCapturePoll(20);
+	//a window that never gets louder than this (-100dBFS) counts as silence, even when wasapi doesn't flag it
+	const float kSilenceLevel = 1e-5f;
+	//what beat tracking gets when the gpu does the chart's fft, the newest ~10ms at 48kHz, plenty for onsets
+	const size_t kBeatFFTSize = 512;
+
+	float MsSince(clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(clock::now() - start).count();
+	}
+}
+
+void FramePipeline::Start(const AnalysisSettings& settings, std::function<bool(size_t)> supportsgpufft, std::function<void()> onsound)
+{
+	mSettings = settings;
+	mSupportsGpuFFT = supportsgpufft;
+	mOnSound = onsound;
+	mLastSound = clock::now().time_since_epoch().count();
+	mCpuSamples.reserve(AnalysisSettings::kMaxFFTSize);
+	mCpuMagnitudes.reserve(AnalysisSettings::kMaxChartBins);
+	mPackets.resize(kPacketCount);
+	for (FramePacket& packet : mPackets)
+	{
+		packet.samples.reserve(AnalysisSettings::kMaxFFTSize);
+		packet.magnitudes.reserve(AnalysisSettings::kMaxChartBins);
+		mFreeFromAnalysis.Push(&packet);
+	}
+	mRunning = true;
+	mCaptureThread = std::thread(&FramePipeline::CaptureLoop, this);
+	mAnalysisThread = std::thread(&FramePipeline::AnalysisLoop, this);
+}
+
+void FramePipeline::Stop()
+{
+	if (!mRunning.exchange(false))
+		return;
+	mWake.notify_all();
+	mCaptureThread.join();
+	mAnalysisThread.join();
+}
+
+void FramePipeline::SetSettings(const AnalysisSettings& settings)
+{
+	std::lock_guard<std::mutex> lock(mSettingsLock);
+	mSettings = settings;
+}
+
+AnalysisSettings FramePipeline::Settings()
+{
+	std::lock_guard<std::mutex> lock(mSettingsLock);
+	return mSettings;
+}
+
+float FramePipeline::SilentSeconds() const
+{
+	clock::time_point last{ clock::duration(mLastSound.load(std::memory_order_relaxed)) };
+	return std::chrono::duration<float>(clock::now() - last).count();
+}
+
+FramePacket* FramePipeline::TakeFree()
+{
+	FramePacket* packet = nullptr;
+	if (mFreeFromAnalysis.Pop(packet) || mFreeFromRender.Pop(packet))
+		return packet;
+	return nullptr;
+}
+
+void FramePipeline::CaptureLoop()
+{
+	TRACE_THREAD("capture");
+	//the com objects stay on the thread that made them, so the whole device lives here
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
+	WASAPILoopbackCapture device;
+	device.Init();
+	PreciseTimer timer;
+	FramePacket* spare = nullptr; //taken from the pool but the analysis queue was full
+	size_t lastcaptured = 0;
+	bool wassilent = false;
+	while (mRunning.load(std::memory_order_relaxed))
+	{
+		auto start = clock::now();
+		device.Capture();
+		AnalysisSettings settings = Settings();
+		//silent for long enough that nobody's drawing anything, windows stop going out until there's sound again
+		bool idle = settings.idleAfter > 0.0f && SilentSeconds() > settings.idleAfter;
+		//with a hop size set, only hand out a window once that many new samples came in
+		size_t collected = device.SamplesCollected();
+		bool due = collected != lastcaptured && (settings.hopSize == 0 || collected < lastcaptured || collected - lastcaptured >= settings.hopSize);
+		if (due)
+		{
+			FramePacket* packet = spare != nullptr ? spare : TakeFree();
+			spare = nullptr;
+			if (packet == nullptr)
+			{
+				//everything downstream is still busy with older windows, try again with a newer one
+				mPoolExhausted.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				TRACE_SCOPE("capture window");
+				device.GetSample(packet->samples, false, settings.fftSize);
+				float peak = 0.0f;
+				for (const fcomplex& sample : packet->samples)
+					peak = std::max(peak, fabsf(sample.real()));
+				bool silent = peak < kSilenceLevel;
+				if (!silent)
+				{
+					mLastSound.store(start.time_since_epoch().count(), std::memory_order_relaxed);
+					if (wassilent && mOnSound)
+						mOnSound();
+				}
+				wassilent = silent;
+				packet->captured = clock::now();
+				packet->sampleRate = device.SampleRate();
+				packet->samplesCollected = collected;
+				packet->captureMs = MsSince(start);
+				packet->captureQueueDepth = device.LastQueueDepth();
+				packet->droppedPackets = device.DroppedPackets();
+				packet->silentPackets = device.SilentPackets();
+				if (idle && silent)
+				{
+					//no point analyzing it, the last silent window already went through
+					spare = packet;
+					lastcaptured = collected;
+				}
+				else if (mCaptured.Push(packet))
+				{
+					lastcaptured = collected;
+					mWake.notify_one();
+				}
+				else
+				{
+					spare = packet;
+				}
+			}
+		}
+		timer.SleepUntil(start + (idle ? kIdleCapturePoll : kCapturePoll), false);
+	}
+	device.Destroy();
+	CoUninitialize();
+}
+
+void FramePipeline::AnalysisLoop()
+{
+	TRACE_THREAD("analysis");
+	while (mRunning.load(std::memory_order_relaxed))
+	{
+		//only the newest window is worth analyzing, the rest go straight back
+		FramePacket* packet = nullptr;
+		FramePacket* next = nullptr;
+		while (mCaptured.Pop(next))
+		{
+			if (packet != nullptr)
+			{
+				mFreeFromAnalysis.Push(packet);
+				mStaleDrops.fetch_add(1, std::memory_order_relaxed);
+			}
+			packet = next;
+		}
+		if (packet == nullptr)
+		{
+			//the capture thread pushes without the lock, a wakeup can slip through between the check and the wait,
+			//the timeout bounds how late that makes us
+			std::unique_lock<std::mutex> lock(mWakeLock);
+			mWake.wait_for(lock, kCapturePoll, [this]() { return !mCaptured.Empty() || !mRunning.load(); });
+			continue;
+		}
+
+		TRACE_SCOPE("analysis");
+		FrameHeapCheck heapcheck("analysis");
+		mArena.NextFrame();
+		auto start = clock::now();
+		AnalysisSettings settings = Settings();
+		//the gpu takes the raw samples, anything it can't do goes through the cpu fft like before
+		packet->gpuFFT = settings.gpuFFT && mSupportsGpuFFT(packet->samples.size());
+		packet->window = settings.window;
+		packet->chartBins = settings.chartBins;
+		packet->magnitudes.clear();
+		//before the cpu fft, that one windows the samples in place
+		packet->pitch = PitchEstimate();
+		if (settings.pitchTracking && !packet->samples.empty())
+			packet->pitch = mPitch.Process(packet->samples.data(), packet->samples.size(), packet->sampleRate, mArena);
+		if (!packet->gpuFFT && !packet->samples.empty())
+		{
+			AnalyzeSpectrum(packet->samples, settings, packet->magnitudes, mArena);
+		}
+		//publishing and recording want the full spectrum, with the gpu fft that's a cpu fft on top
+		bool fullcpu = (mPublisher != nullptr || mRecorder != nullptr) && !packet->samples.empty();
+		const std::vector<float>* cpu = &packet->magnitudes;
+		if (fullcpu && packet->gpuFFT)
+		{
+			mCpuSamples.assign(packet->samples.begin(), packet->samples.end());
+			AnalyzeSpectrum(mCpuSamples, settings, mCpuMagnitudes, mArena);
+			cpu = &mCpuMagnitudes;
+		}
+		if (settings.beatTracking && !packet->samples.empty())
+		{
+			TRACE_SCOPE("beat tracking");
+			//whatever cpu spectrum there already is, otherwise just the newest few ms through a small fft. the gpu
+			//keeps its spectrum on the gpu and a full size cpu fft next to it would undo the point of it
+			const std::vector<float>* beats = cpu;
+			if (packet->gpuFFT && !fullcpu)
+			{
+				size_t size = std::min(kBeatFFTSize, packet->samples.size());
+				mCpuSamples.assign(packet->samples.end() - size, packet->samples.end());
+				AnalysisSettings small = settings;
+				small.window = WindowFunction::Hann;
+				small.chartBins = size / 2;
+				AnalyzeSpectrum(mCpuSamples, small, mCpuMagnitudes, mArena);
+				beats = &mCpuMagnitudes;
+			}
+			int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(packet->captured.time_since_epoch()).count();
+			mBeats.Process(beats->data(), beats->size(), us);
+		}
+		if (fullcpu)
+		{
+			uint32_t bins = (uint32_t)cpu->size();
+			uint32_t fftsize = (uint32_t)packet->samples.size();
+			TRACE_SCOPE("publish and record");
+			if (mPublisher != nullptr)
+				mPublisher->Publish(cpu->data(), bins, packet->sampleRate, fftsize, packet->captured, mBeats.State());
+			if (mRecorder != nullptr)
+				mRecorder->Append(cpu->data(), bins, packet->sampleRate, fftsize, packet->samplesCollected, packet->captured);
+		}
+		packet->rhythm = mBeats.State();
+		packet->analysisMs = MsSince(start);
+		if (!mAnalyzed.Push(packet))
+		{
+			mFreeFromAnalysis.Push(packet);
+			mStaleDrops.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+const FramePacket* FramePipeline::Latest(bool& fresh)
+{
+	FramePacket* packet = nullptr;
+	FramePacket* next = nullptr;
+	while (mAnalyzed.Pop(next))
+	{
+		if (packet != nullptr)
+		{
+			mFreeFromRender.Push(packet);
+			mStaleDrops.fetch_add(1, std::memory_order_relaxed);
+		}
+		packet = next;
+	}
+	fresh = packet != nullptr;
+	if (fresh)
+	{
+		if (mRendering != nullptr)
+			mFreeFromRender.Push(mRendering);
+		mRendering = packet;
+	}
+	return mRendering;
+}
@@ -0,0 +1,105 @@
+#ifndef WINORB_FRAME_PIPELINE_H
+#define WINORB_FRAME_PIPELINE_H
+
+#include "Analyzer.h"
+#include "SpscQueue.h"
+#include "SpectrumPublisher.h"
+#include "SpectrumRecording.h"
+#include "BeatTracker.h"
+#include "PitchTracker.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//one window of audio on its way from the capture thread through analysis to the render loop. all of them get
+//allocated up front and go round in circles, so nothing allocates per frame
+struct FramePacket
+{
+	complex_sample samples; //raw, what the gpu fft takes
+	std::vector<float> magnitudes; //the cpu analysis, empty when the gpu does the fft
+	WindowFunction window = WindowFunction::Rectangular;
+	bool gpuFFT = false;
+	size_t chartBins = 0;
+	unsigned sampleRate = 0;
+	uint64_t samplesCollected = 0; //the capture's running count when this window got taken
+	std::chrono::steady_clock::time_point captured;
+	float captureMs = 0.0f;
+	float analysisMs = 0.0f;
+	//capture device counters as of this packet
+	unsigned captureQueueDepth = 0;
+	uint64_t droppedPackets = 0;
+	uint64_t silentPackets = 0;
+	RhythmState rhythm; //onsets and beats counted up to this packet, see AnalysisSettings::beatTracking
+	PitchEstimate pitch; //of this window, see AnalysisSettings::pitchTracking
+};
+
+//capture -> analysis -> render, the first two on their own threads, connected by lock-free queues. frame n+1
+//gets captured and analyzed while the main thread still renders frame n. every stage only ever wants the
+//newest packet, so consumers skip over whatever piled up and stale packets go straight back to the pool
+//the chart mesh gets built in chart.comp, so there's no cpu mesh stage, it's part of the render
+class FramePipeline
+{
+public:
+	static const size_t kQueueSize = 4; //holds 3
+	static const size_t kPacketCount = 10; //both queues full + one per stage + the one being rendered
+	~FramePipeline() { Stop(); };
+	//the capture device lives entirely on the capture thread. supportsgpufft gets asked from the analysis thread,
+	//onsound from the capture thread whenever a window with sound in it follows a silent one
+	void Start(const AnalysisSettings& settings, std::function<bool(size_t)> supportsgpufft, std::function<void()> onsound);
+	void Stop();
+	//before Start, every analyzed frame gets published/recorded there too. the gpu fft keeps its magnitudes on
+	//the gpu, so with either of them the cpu analysis runs for those frames as well
+	void SetPublisher(SpectrumPublisher* publisher) { mPublisher = publisher; };
+	void SetRecorder(SpectrumRecorder* recorder) { mRecorder = recorder; };
+	void SetSettings(const AnalysisSettings& settings);
+	//newest analyzed packet, or the last one again when nothing new came in (null before the first).
+	//stays valid until the next call, render thread only
+	const FramePacket* Latest(bool& fresh);
+	uint64_t StaleDrops() const { return mStaleDrops.load(std::memory_order_relaxed); };
+	uint64_t PoolExhausted() const { return mPoolExhausted.load(std::memory_order_relaxed); };
+	//how long it's been since the last window that wasn't silence (or since Start), any thread
+	float SilentSeconds() const;
+private:
+	typedef SpscQueue<FramePacket*, kQueueSize> PacketQueue;
+	typedef SpscQueue<FramePacket*, 16> FreeQueue; //holds 15, more than kPacketCount so it never fills up
+	void CaptureLoop();
+	void AnalysisLoop();
+	AnalysisSettings Settings();
+	FramePacket* TakeFree(); //capture thread only
+
+	std::vector<FramePacket> mPackets;
+	PacketQueue mCaptured; //capture -> analysis
+	PacketQueue mAnalyzed; //analysis -> render
+	//back to the capture thread, one queue per thread that hands them back so each stays single producer
+	FreeQueue mFreeFromAnalysis;
+	FreeQueue mFreeFromRender;
+	FramePacket* mRendering = nullptr;
+
+	std::mutex mSettingsLock; //just the knobs, the packets never take it
+	AnalysisSettings mSettings;
+	std::function<bool(size_t)> mSupportsGpuFFT;
+	std::function<void()> mOnSound;
+	SpectrumPublisher* mPublisher = nullptr;
+	SpectrumRecorder* mRecorder = nullptr;
+	complex_sample mCpuSamples; //analysis thread only, AnalyzeSpectrum windows in place
+	FrameArena mArena; //analysis thread only, the fft's scratch for one packet
+	BeatTracker mBeats; //analysis thread only
+	PitchTracker mPitch; //analysis thread only
+	std::vector<float> mCpuMagnitudes;
+	std::atomic<int64_t> mLastSound{ 0 }; //steady_clock ticks
+	//only so the analysis thread can sleep while there's nothing to do
+	std::mutex mWakeLock;
+	std::condition_variable mWake;
+
+	std::atomic<bool> mRunning{ false };
+	std::atomic<uint64_t> mStaleDrops{ 0 };
+	std::atomic<uint64_t> mPoolExhausted{ 0 };
+	std::thread mCaptureThread;
+	std::thread mAnalysisThread;
+};
+
+#endif //!WINORB_FRAME_PIPELINE_H
@@ -0,0 +1,79 @@
+#include "Icosphere.h"
+#include "glm/geometric.hpp"
+#include <math.h>
+#include <iterator>
+#include <unordered_map>
+
+namespace
+{
+	//shared edges get one midpoint, keyed on the (sorted) pair of vertex indices
+	uint32_t Midpoint(uint32_t a, uint32_t b, std::vector<Vertex3>& vertices, std::unordered_map<uint64_t, uint32_t>& cache)
+	{
+		uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+		auto found = cache.find(key);
+		if (found != cache.end())
+			return found->second;
+
+		Vertex3 mid{};
+		mid.pos = glm::normalize((vertices[a].pos + vertices[b].pos) * 0.5f);
+		uint32_t index = (uint32_t)vertices.size();
+		vertices.push_back(mid);
+		cache.emplace(key, index);
+		return index;
+	}
+}
+
+void GenerateIcosphere(uint32_t subdivisions, std::vector<Vertex3>& vertices, std::vector<uint32_t>& indices)
+{
+	const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+	const glm::vec3 corners[12] =
+	{
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+		{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+		{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+	};
+	const uint32_t faces[] =
+	{
+		0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+		1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+		3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+		4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1,
+	};
+
+	vertices.clear();
+	vertices.reserve(10 * ((size_t)1 << (2 * subdivisions)) + 2);
+	for (const glm::vec3& corner : corners)
+	{
+		Vertex3 v{};
+		v.pos = glm::normalize(corner);
+		vertices.push_back(v);
+	}
+	indices.assign(std::begin(faces), std::end(faces));
+
+	std::unordered_map<uint64_t, uint32_t> cache;
+	for (uint32_t level = 0; level < subdivisions; ++level)
+	{
+		std::vector<uint32_t> split;
+		split.reserve(indices.size() * 4);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t a = indices[i];
+			uint32_t b = indices[i + 1];
+			uint32_t c = indices[i + 2];
+			uint32_t ab = Midpoint(a, b, vertices, cache);
+			uint32_t bc = Midpoint(b, c, vertices, cache);
+			uint32_t ca = Midpoint(c, a, vertices, cache);
+			uint32_t tris[] = { a, ab, ca,  b, bc, ab,  c, ca, bc,  ab, bc, ca };
+			split.insert(split.end(), std::begin(tris), std::end(tris));
+		}
+		indices.swap(split);
+		cache.clear();
+	}
+
+	//cool at the poles, warm around the equator, the shader pushes it towards white with the level
+	for (Vertex3& v : vertices)
+	{
+		float equator = 1.0f - fabsf(v.pos.y);
+		v.color = glm::mix(glm::vec3(0.1f, 0.3f, 0.9f), glm::vec3(0.9f, 0.2f, 0.5f), equator);
+	}
+}
@@ -0,0 +1,12 @@
+#ifndef WINORB_ICOSPHERE_H
+#define WINORB_ICOSPHERE_H
+
+#include "Vertex.h"
+#include <stdint.h>
+#include <vector>
+
+//unit icosphere, every subdivision splits each triangle in 4 and pushes the new vertices back out onto the sphere
+//20 * 4^n triangles and 10 * 4^n + 2 vertices, counter-clockwise seen from outside
+void GenerateIcosphere(uint32_t subdivisions, std::vector<Vertex3>& vertices, std::vector<uint32_t>& indices);
+
+#endif //!WINORB_ICOSPHERE_H
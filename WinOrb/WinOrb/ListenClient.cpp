@@ -0,0 +1,78 @@
+#include "ListenClient.h"
+#include "SpectrumReader.h"
+#include <windows.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+
+int RunListen()
+{
+	SpectrumReader reader;
+	fprintf(stderr, "waiting for a WinOrb running with --publish, ctrl+c to stop\n");
+	while (!reader.Open())
+		Sleep(500);
+
+	uint64_t next = 0;
+	uint64_t received = 0;
+	uint64_t missed = 0;
+	uint64_t torn = 0;
+	auto lastprint = std::chrono::steady_clock::now();
+	auto lastframe = lastprint;
+	while (true)
+	{
+		SpectrumView view;
+		if (!reader.Latest(view, next))
+		{
+			//quiet for a while, either it's idling through silence or the publisher went away/got replaced
+			auto now = std::chrono::steady_clock::now();
+			if (now - lastframe > std::chrono::seconds(1))
+			{
+				lastframe = now;
+				if (reader.Stale())
+				{
+					reader.Close();
+					fprintf(stderr, "the publisher went away, waiting for a WinOrb running with --publish again\n");
+					while (!reader.Open())
+						Sleep(500);
+					next = 0;
+					received = 0;
+				}
+			}
+			Sleep(2);
+			continue;
+		}
+		lastframe = std::chrono::steady_clock::now();
+
+		//straight off the shared memory, only trusted once StillValid says nobody wrote over it meanwhile
+		uint32_t loudest = 0;
+		for (uint32_t i = 1; i < view.bins; ++i)
+		{
+			if (view.magnitudes[i] > view.magnitudes[loudest])
+				loudest = i;
+		}
+		float magnitude = view.bins > 0 ? view.magnitudes[loudest] : 0.0f;
+		if (!reader.StillValid(view))
+		{
+			++torn;
+			continue;
+		}
+		if (received > 0 && view.frame > next)
+			missed += view.frame - next;
+		next = view.frame + 1;
+		++received;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastprint > std::chrono::milliseconds(250))
+		{
+			float nyquist = view.sampleRate * 0.5f;
+			float hz = view.bins > 0 ? (loudest + 0.5f) * nyquist / view.bins : 0.0f;
+			float db = magnitude > 0.0f ? 20.0f * log10f(magnitude) : -999.0f;
+			int64_t nowns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+			fprintf(stderr, "frame %8llu %5u bins @ %uHz, loudest %7.1fHz %6.1fdB, %5.1fbpm beat %llu, age %5.1fms, received %llu missed %llu torn %llu\n",
+				(unsigned long long)view.frame, view.bins, view.sampleRate, hz, db, view.bpm, (unsigned long long)view.beats,
+				(nowns - view.timestampNs) / 1e6, (unsigned long long)received, (unsigned long long)missed, (unsigned long long)torn);
+			lastprint = now;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef WINORB_LISTEN_CLIENT_H
+#define WINORB_LISTEN_CLIENT_H
+
+//WinOrb.exe --listen
+//a test client for the shared memory spectra another WinOrb publishes with --publish, prints what it reads
+//through SpectrumReader a few times a second: frame rate, how many frames it missed or saw torn, the loudest bin
+//goes back to waiting when the publisher quits, and picks up a new one that takes over the memory
+int RunListen();
+
+#endif //!WINORB_LISTEN_CLIENT_H
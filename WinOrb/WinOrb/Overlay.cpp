@@ -0,0 +1,205 @@
+#include "Overlay.h"
+#include "imgui.h"
+#include <stdio.h>
+
+namespace
+{
+	void PlotStage(const FrameProfiler& profiler, ProfileStage stage, float height)
+	{
+		const RollingStats& stats = profiler.Get(stage);
+		float samples[RollingStats::kWindow];
+		size_t count = stats.CopySamples(samples);
+		char label[64];
+		snprintf(label, sizeof(label), "%s %.2fms", ProfileStageName(stage), stats.Last());
+		ImGui::PlotLines(label, samples, (int)count, 0, nullptr, 0.0f, stats.P99() * 1.25f + 0.001f, ImVec2(0, height));
+	}
+
+	void StageRow(const FrameProfiler& profiler, ProfileStage stage)
+	{
+		const RollingStats& stats = profiler.Get(stage);
+		if (stats.Count() == 0)
+			return;
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(ProfileStageName(stage));
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.Min());
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.Avg());
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", stats.P99());
+	}
+}
+
+bool DrawPerfOverlay(const OverlayStats& stats, AnalysisSettings& settings, ChartStyle& style, PacingSettings& pacing)
+{
+	bool changed = false;
+	ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowBgAlpha(0.75f);
+	if (!ImGui::Begin("orb internals (F1)"))
+	{
+		ImGui::End();
+		return false;
+	}
+
+	if (stats.profiler != nullptr)
+	{
+		const FrameProfiler& profiler = *stats.profiler;
+		PlotStage(profiler, ProfileStage::Frame, 60.0f);
+		PlotStage(profiler, ProfileStage::GpuFrame, 40.0f);
+
+		if (ImGui::BeginTable("stages", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+		{
+			ImGui::TableSetupColumn("stage (ms)");
+			ImGui::TableSetupColumn("min");
+			ImGui::TableSetupColumn("avg");
+			ImGui::TableSetupColumn("p99");
+			ImGui::TableHeadersRow();
+			for (size_t i = 0; i < (size_t)ProfileStage::Count; ++i)
+				StageRow(profiler, (ProfileStage)i);
+			ImGui::EndTable();
+		}
+	}
+
+	ImGui::Separator();
+	ImGui::Text("capture queue depth %u", stats.captureQueueDepth);
+	ImGui::Text("dropped packets %llu, silent packets %llu", (unsigned long long)stats.droppedPackets, (unsigned long long)stats.silentPackets);
+	ImGui::Text("device allocations %llu", (unsigned long long)stats.deviceAllocations);
+	ImGui::Text("stale windows skipped %llu", (unsigned long long)stats.staleFrames);
+
+	ImGui::Separator();
+	if (ImGui::BeginCombo("pacing", PacingModeName(pacing.mode)))
+	{
+		for (int i = 0; i < (int)PacingMode::Count; ++i)
+		{
+			bool selected = (int)pacing.mode == i;
+			if (ImGui::Selectable(PacingModeName((PacingMode)i), selected))
+				pacing.mode = (PacingMode)i;
+		}
+		ImGui::EndCombo();
+	}
+	if (pacing.mode == PacingMode::TargetRate)
+		ImGui::SliderFloat("target rate", &pacing.targetRate, 10.0f, 360.0f, "%.0f fps");
+	if (stats.pacer != nullptr)
+	{
+		const FramePacer& pacer = *stats.pacer;
+		ImGui::Text("missed deadlines %llu of %llu, work p99 %.2fms", (unsigned long long)pacer.MissedDeadlines(), (unsigned long long)pacer.Frames(), pacer.WorkTime().P99());
+	}
+
+	ImGui::Separator();
+	//fft size as a power of two slider, so it can't land on something the fft chokes on
+	int fftlog2 = 0;
+	while (((size_t)1 << fftlog2) < settings.fftSize)
+		++fftlog2;
+	int minlog2 = 0;
+	while (((size_t)1 << minlog2) < AnalysisSettings::kMinFFTSize)
+		++minlog2;
+	int maxlog2 = minlog2;
+	while (((size_t)1 << maxlog2) < AnalysisSettings::kMaxFFTSize)
+		++maxlog2;
+	char fftlabel[32];
+	snprintf(fftlabel, sizeof(fftlabel), "%zu", settings.fftSize);
+	if (ImGui::SliderInt("fft size", &fftlog2, minlog2, maxlog2, fftlabel))
+	{
+		settings.fftSize = (size_t)1 << fftlog2;
+		changed = true;
+	}
+
+	//same deal for the bar count, the chart rebuilds its buffers when this moves so it's not something to drag around
+	int barslog2 = 0;
+	while (((size_t)1 << barslog2) < settings.chartBins)
+		++barslog2;
+	int minbars = 0;
+	while (((size_t)1 << minbars) < AnalysisSettings::kMinChartBins)
+		++minbars;
+	int maxbars = minbars;
+	while (((size_t)1 << maxbars) < AnalysisSettings::kMaxChartBins)
+		++maxbars;
+	char barslabel[32];
+	snprintf(barslabel, sizeof(barslabel), "%zu", settings.chartBins);
+	if (ImGui::SliderInt("bars", &barslog2, minbars, maxbars, barslabel))
+	{
+		settings.chartBins = (size_t)1 << barslog2;
+		changed = true;
+	}
+
+	if (ImGui::BeginCombo("window", WindowFunctionName(settings.window)))
+	{
+		for (int i = 0; i < (int)WindowFunction::Count; ++i)
+		{
+			bool selected = (int)settings.window == i;
+			if (ImGui::Selectable(WindowFunctionName((WindowFunction)i), selected))
+			{
+				settings.window = (WindowFunction)i;
+				changed = true;
+			}
+		}
+		ImGui::EndCombo();
+	}
+
+	int hop = (int)settings.hopSize;
+	if (ImGui::SliderInt("hop size", &hop, 0, (int)settings.fftSize, hop == 0 ? "every frame" : "%d"))
+	{
+		settings.hopSize = (size_t)hop;
+		changed = true;
+	}
+
+	changed |= ImGui::SliderFloat("idle after", &settings.idleAfter, 0.0f, 60.0f, settings.idleAfter > 0.0f ? "%.0fs of silence" : "never");
+
+	changed |= ImGui::Checkbox("gpu fft", &settings.gpuFFT);
+	ImGui::SameLine();
+	ImGui::TextDisabled(stats.gpuFFTActive ? "(running on the gpu)" : "(running on the cpu)");
+
+	changed |= ImGui::Checkbox("beat tracking", &settings.beatTracking);
+	if (settings.beatTracking)
+	{
+		ImGui::SameLine();
+		if (stats.rhythm.bpm > 0.0f)
+			ImGui::Text("%.1f bpm, %.0f%% sure, %llu onsets", stats.rhythm.bpm, stats.rhythm.confidence * 100.0f, (unsigned long long)stats.rhythm.onsets);
+		else
+			ImGui::TextDisabled("(listening for a beat)");
+		if (stats.gpuFFTActive)
+			ImGui::TextDisabled("beats come off a small cpu fft of the newest samples, the gpu keeps the chart's");
+	}
+
+	changed |= ImGui::Checkbox("pitch tracking", &settings.pitchTracking);
+	if (settings.pitchTracking)
+	{
+		ImGui::SameLine();
+		if (stats.pitch.hz > 0.0f)
+			ImGui::Text("%s%d %+3.0f cents, %.1f Hz", NoteName(stats.pitch.note), stats.pitch.note / 12 - 1, stats.pitch.cents, stats.pitch.hz);
+		else
+			ImGui::TextDisabled("(no clear pitch)");
+	}
+
+	ImGui::Separator();
+	//presets just overwrite everything, the sliders below tweak from there
+	if (ImGui::BeginCombo("chart preset", "pick..."))
+	{
+		for (int i = 0; i < (int)ChartPreset::Count; ++i)
+		{
+			if (ImGui::Selectable(ChartPresetName((ChartPreset)i)))
+			{
+				style = MakeChartStyle((ChartPreset)i);
+				changed = true;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	changed |= ImGui::SliderFloat("attack", &style.attack, 0.01f, 1.0f);
+	changed |= ImGui::SliderFloat("release", &style.release, 0.01f, 1.0f);
+	changed |= ImGui::SliderFloat("peak hold", &style.peakHoldFrames, 0.0f, 120.0f, "%.0f frames");
+	changed |= ImGui::SliderFloat("peak decay", &style.peakDecay, 0.001f, 0.1f, "%.3f");
+	bool normalize = style.normalize != 0;
+	if (ImGui::Checkbox("normalize", &normalize))
+	{
+		style.normalize = normalize ? 1 : 0;
+		changed = true;
+	}
+	ImGui::SameLine();
+	bool peaks = style.showPeaks != 0;
+	if (ImGui::Checkbox("peaks", &peaks))
+	{
+		style.showPeaks = peaks ? 1 : 0;
+		changed = true;
+	}
+
+	ImGui::End();
+	return changed;
+}
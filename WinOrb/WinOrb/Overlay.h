@@ -0,0 +1,32 @@
+#ifndef WINORB_OVERLAY_H
+#define WINORB_OVERLAY_H
+
+#include "Profiler.h"
+#include "Analyzer.h"
+#include "ChartStyle.h"
+#include "FramePacer.h"
+#include "BeatTracker.h"
+#include "PitchTracker.h"
+#include <stdint.h>
+
+//everything the perf overlay shows that doesn't live in the profiler
+struct OverlayStats
+{
+	const FrameProfiler* profiler = nullptr;
+	const FramePacer* pacer = nullptr;
+	unsigned captureQueueDepth = 0;
+	uint64_t droppedPackets = 0;
+	uint64_t silentPackets = 0;
+	uint64_t deviceAllocations = 0;
+	uint64_t staleFrames = 0; //windows the pipeline skipped because a newer one was already waiting
+	bool gpuFFTActive = false; //whether the last analysis actually ran on the gpu
+	RhythmState rhythm;
+	PitchEstimate pitch;
+};
+
+//dear imgui window with frame time graphs, stage timings and the live analysis, pacing and chart knobs
+//has to be called between ImGui::NewFrame and ImGui::Render, returns true if analysis or chart settings changed,
+//pacing gets picked up by whoever owns the pacer every frame
+bool DrawPerfOverlay(const OverlayStats& stats, AnalysisSettings& settings, ChartStyle& style, PacingSettings& pacing);
+
+#endif //!WINORB_OVERLAY_H
@@ -0,0 +1,138 @@
+#include "PitchTracker.h"
+#include "Trace.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	const float kWindowSeconds = 0.04f; //two periods of the lowest note
+	const float kMinHz = 50.0f;
+	const float kMaxHz = 1500.0f; //singing, and most of what plays a tune
+	const float kPeakCutoff = 0.93f; //of the highest key maximum, the first peak past this is the pitch
+	const float kMinClarity = 0.8f; //below this the window's noise, a chord or a consonant
+	const float kSilenceRms = 0.003f; //about -50dBFS
+	const char* kNoteNames[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+	size_t NextPowerOfTwo(size_t n)
+	{
+		size_t size = 1;
+		while (size < n)
+			size *= 2;
+		return size;
+	}
+}
+
+const char* NoteName(int note)
+{
+	return note >= 0 ? kNoteNames[note % 12] : "?";
+}
+
+PitchEstimate PitchTracker::Process(const fcomplex* samples, size_t count, unsigned sampleRate, FrameArena& arena)
+{
+	TRACE_SCOPE("pitch");
+	PitchEstimate estimate;
+	size_t window = std::min(std::min(count, kMaxWindow), (size_t)(kWindowSeconds * sampleRate));
+	size_t minlag = (size_t)(sampleRate / kMaxHz);
+	size_t maxlag = std::min(window / 2, (size_t)(sampleRate / kMinHz));
+	if (sampleRate == 0 || minlag < 2 || maxlag <= minlag + 1)
+		return estimate;
+	samples += count - window;
+
+	size_t mark = arena.Mark();
+	float* x = arena.Allocate<float>(window);
+	float mean = 0.0f;
+	for (size_t i = 0; i < window; ++i)
+		mean += samples[i].real();
+	mean /= window;
+	float energy = 0.0f;
+	for (size_t i = 0; i < window; ++i)
+	{
+		x[i] = samples[i].real() - mean;
+		energy += x[i] * x[i];
+	}
+	if (sqrtf(energy / window) < kSilenceRms)
+	{
+		arena.Rewind(mark);
+		return estimate;
+	}
+
+	//r(t) for every lag at once, the padding keeps the wrapped around products out of the lags we look at
+	size_t size = NextPowerOfTwo(2 * window);
+	mCorrelation.resize(size);
+	for (size_t i = 0; i < window; ++i)
+		mCorrelation[i] = fcomplex(x[i], 0.0f);
+	std::fill(mCorrelation.begin() + window, mCorrelation.end(), fcomplex(0.0f, 0.0f));
+	FFT(mCorrelation, arena);
+	for (fcomplex& val : mCorrelation)
+		val = fcomplex(std::norm(val), 0.0f);
+	IFFT(mCorrelation, arena);
+
+	//m(t) drops the two samples that stop overlapping with every step
+	float* nsdf = arena.Allocate<float>(maxlag + 2);
+	float m = 2.0f * energy;
+	for (size_t lag = 0; lag <= maxlag + 1; ++lag)
+	{
+		if (lag > 0)
+			m -= x[lag - 1] * x[lag - 1] + x[window - lag] * x[window - lag];
+		nsdf[lag] = m > 1e-9f ? 2.0f * mCorrelation[lag].real() / m : 0.0f;
+	}
+
+	//a key maximum is the highest point between the nsdf going positive and going negative again, the lobe
+	//around lag 0 doesn't count. the last lobe can still be rising at maxlag, it counts as well
+	size_t keys[64];
+	size_t keycount = 0;
+	float highest = 0.0f;
+	size_t lag = 1;
+	while (lag <= maxlag && nsdf[lag] > 0.0f)
+		++lag;
+	size_t best = 0;
+	for (; lag <= maxlag; ++lag)
+	{
+		bool positive = nsdf[lag] > 0.0f;
+		if (positive && (best == 0 || nsdf[lag] > nsdf[best]))
+			best = lag;
+		if ((!positive || lag == maxlag) && best != 0)
+		{
+			if (best >= minlag && keycount < 64)
+			{
+				keys[keycount++] = best;
+				highest = std::max(highest, nsdf[best]);
+			}
+			best = 0;
+		}
+	}
+	size_t pick = 0;
+	for (size_t k = 0; k < keycount && pick == 0; ++k)
+	{
+		if (nsdf[keys[k]] >= kPeakCutoff * highest)
+			pick = keys[k];
+	}
+	if (pick == 0)
+	{
+		arena.Rewind(mark);
+		return estimate;
+	}
+
+	//maxlag + 1 got computed too, so every pick has neighbours on both sides
+	float before = nsdf[pick - 1];
+	float peak = nsdf[pick];
+	float after = nsdf[pick + 1];
+	float curve = before - 2.0f * peak + after;
+	float offset = 0.0f;
+	float clarity = peak;
+	if (curve < 0.0f)
+	{
+		offset = std::min(0.5f, std::max(-0.5f, 0.5f * (before - after) / curve));
+		clarity = peak - 0.25f * (before - after) * offset;
+	}
+	arena.Rewind(mark);
+
+	estimate.clarity = std::min(1.0f, clarity);
+	if (estimate.clarity < kMinClarity)
+		return estimate;
+	estimate.hz = sampleRate / (pick + offset);
+	float midi = 69.0f + 12.0f * log2f(estimate.hz / 440.0f);
+	estimate.note = (int)floorf(midi + 0.5f);
+	estimate.cents = 100.0f * (midi - estimate.note);
+	return estimate;
+}
@@ -0,0 +1,35 @@
+#ifndef WINORB_PITCH_TRACKER_H
+#define WINORB_PITCH_TRACKER_H
+
+#include "FFT.h"
+#include <stddef.h>
+
+//one window's pitch, hz is 0 when nothing in it was periodic enough to call a note
+struct PitchEstimate
+{
+	float hz = 0.0f;
+	float clarity = 0.0f; //height of the nsdf peak, 1 for a perfectly periodic window
+	int note = -1; //midi, 69 is A4
+	float cents = 0.0f; //off that note, -50 to 50
+};
+
+//"A", "C#"... for a midi note, the octave is note / 12 - 1
+const char* NoteName(int note);
+
+//monophonic pitch with the mcleod pitch method: the normalized square difference function
+//  nsdf(t) = 2 * r(t) / m(t), r the autocorrelation and m the energy of both overlapping parts
+//(yin's difference function is m(t) - 2 * r(t), the same two sums). r comes from the fft, zero padded to twice the
+//window so it's linear and not circular, then |X|^2 and back with the ifft, O(n log n) instead of O(n^2).
+//the pitch is the first peak that gets close to the highest one (so the octave below a strong harmonic doesn't win),
+//refined between lags with a parabola through it and its neighbours
+class PitchTracker
+{
+public:
+	static const size_t kMaxWindow = 4096;
+	//off the newest 40ms of samples (the real parts), or all of them if there are fewer. the scratch comes out of the arena
+	PitchEstimate Process(const fcomplex* samples, size_t count, unsigned sampleRate, FrameArena& arena);
+private:
+	complex_sample mCorrelation; //kept around, only ever grows
+};
+
+#endif //!WINORB_PITCH_TRACKER_H
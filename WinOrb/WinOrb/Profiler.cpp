@@ -0,0 +1,92 @@
+#include "Profiler.h"
+#include <algorithm>
+
+void RollingStats::Add(float ms)
+{
+	mSamples[mNext] = ms;
+	mNext = (mNext + 1) % kWindow;
+	if (mCount < kWindow)
+		++mCount;
+}
+
+float RollingStats::Last() const
+{
+	if (mCount == 0)
+		return 0.0f;
+	return mSamples[(mNext + kWindow - 1) % kWindow];
+}
+
+float RollingStats::Min() const
+{
+	if (mCount == 0)
+		return 0.0f;
+	float minval = mSamples[0];
+	for (size_t i = 1; i < mCount; ++i)
+		minval = std::min(minval, mSamples[i]);
+	return minval;
+}
+
+float RollingStats::Avg() const
+{
+	if (mCount == 0)
+		return 0.0f;
+	float sum = 0.0f;
+	for (size_t i = 0; i < mCount; ++i)
+		sum += mSamples[i];
+	return sum / mCount;
+}
+
+float RollingStats::P99() const
+{
+	if (mCount == 0)
+		return 0.0f;
+	float sorted[kWindow];
+	std::copy(mSamples, mSamples + mCount, sorted);
+	size_t rank = (mCount * 99) / 100;
+	if (rank >= mCount)
+		rank = mCount - 1;
+	std::nth_element(sorted, sorted + rank, sorted + mCount);
+	return sorted[rank];
+}
+
+size_t RollingStats::CopySamples(float (&out)[kWindow]) const
+{
+	size_t start = (mNext + kWindow - mCount) % kWindow;
+	for (size_t i = 0; i < mCount; ++i)
+		out[i] = mSamples[(start + i) % kWindow];
+	return mCount;
+}
+
+const char* ProfileStageName(ProfileStage stage)
+{
+	switch (stage)
+	{
+	case ProfileStage::Frame: return "frame";
+	case ProfileStage::Capture: return "capture";
+	case ProfileStage::Analysis: return "analysis";
+	case ProfileStage::Latency: return "capture to render";
+	case ProfileStage::UpdateChart: return "update chart";
+	case ProfileStage::Upload: return "upload";
+	case ProfileStage::FenceWait: return "fence wait";
+	case ProfileStage::Acquire: return "acquire";
+	case ProfileStage::Submit: return "submit";
+	case ProfileStage::Present: return "present";
+	case ProfileStage::Pacing: return "pacing";
+	case ProfileStage::GpuFrame: return "gpu frame";
+	case ProfileStage::GpuRenderPass: return "gpu render pass";
+	case ProfileStage::GpuTransfer: return "gpu transfer";
+	default: return "?";
+	}
+}
+
+void FrameProfiler::Log(FILE* out) const
+{
+	fprintf(out, "%-16s %8s %8s %8s   (ms, last %zu frames)\n", "stage", "min", "avg", "p99", RollingStats::kWindow);
+	for (size_t i = 0; i < (size_t)ProfileStage::Count; ++i)
+	{
+		const RollingStats& stats = mStats[i];
+		if (stats.Count() == 0)
+			continue;
+		fprintf(out, "%-16s %8.3f %8.3f %8.3f\n", ProfileStageName((ProfileStage)i), stats.Min(), stats.Avg(), stats.P99());
+	}
+}
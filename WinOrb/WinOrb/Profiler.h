@@ -0,0 +1,83 @@
+#ifndef WINORB_PROFILER_H
+#define WINORB_PROFILER_H
+
+#include "Trace.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <chrono>
+
+//keeps the last kWindow samples (in ms) around for min/avg/p99
+class RollingStats
+{
+public:
+	static const size_t kWindow = 240;
+	void Add(float ms);
+	float Last() const;
+	float Min() const;
+	float Avg() const;
+	float P99() const;
+	size_t Count() const { return mCount; };
+	//oldest to newest, for graphs
+	size_t CopySamples(float (&out)[kWindow]) const;
+private:
+	float mSamples[kWindow] = {};
+	size_t mNext = 0;
+	size_t mCount = 0;
+};
+
+enum class ProfileStage
+{
+	//cpu
+	Frame, //start of one Update to the next
+	Capture, //polling wasapi + copying out the window, on the capture thread
+	Analysis, //fft + magnitudes, timed by whoever runs the analysis
+	Latency, //from the window getting captured to the frame showing it starting to render
+	UpdateChart,
+	Upload, //chart magnitudes into the mapped input buffer + waterfall row
+	FenceWait,
+	Acquire,
+	Submit,
+	Present,
+	Pacing, //sleeping in the frame pacer
+	//gpu, from timestamp queries
+	GpuFrame,
+	GpuRenderPass,
+	GpuTransfer,
+	Count
+};
+
+const char* ProfileStageName(ProfileStage stage);
+
+class FrameProfiler
+{
+public:
+	void Add(ProfileStage stage, float ms) { mStats[(size_t)stage].Add(ms); };
+	const RollingStats& Get(ProfileStage stage) const { return mStats[(size_t)stage]; };
+	void Log(FILE* out) const;
+private:
+	RollingStats mStats[(size_t)ProfileStage::Count];
+};
+
+//also a trace event named after the stage when tracing
+class ScopedTimer
+{
+public:
+	ScopedTimer(FrameProfiler& profiler, ProfileStage stage) : mProfiler(profiler), mStage(stage), mStart(std::chrono::steady_clock::now())
+#ifdef WINORB_TRACE
+		, mTrace(ProfileStageName(stage))
+#endif
+	{};
+	~ScopedTimer()
+	{
+		mProfiler.Add(mStage, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - mStart).count());
+	};
+private:
+	FrameProfiler& mProfiler;
+	ProfileStage mStage;
+	std::chrono::steady_clock::time_point mStart;
+#ifdef WINORB_TRACE
+	TraceScope mTrace;
+#endif
+};
+
+#endif //!WINORB_PROFILER_H
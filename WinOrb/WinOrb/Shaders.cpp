@@ -0,0 +1,130 @@
+#include "Shaders.h"
+#include "File.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//generated/*.inc are written by glslc -mfmt=num, see the CustomBuild items in WinOrb.vcxproj
+	constexpr uint32_t kShaderVertSpv[] =
+	{
+#include "generated/shader.vert.inc"
+	};
+
+	constexpr uint32_t kShaderFragSpv[] =
+	{
+#include "generated/shader.frag.inc"
+	};
+
+	constexpr uint32_t kWaterfallVertSpv[] =
+	{
+#include "generated/waterfall.vert.inc"
+	};
+
+	constexpr uint32_t kWaterfallFragSpv[] =
+	{
+#include "generated/waterfall.frag.inc"
+	};
+
+	constexpr uint32_t kChartCompSpv[] =
+	{
+#include "generated/chart.comp.inc"
+	};
+
+	constexpr uint32_t kFFTCompSpv[] =
+	{
+#include "generated/fft.comp.inc"
+	};
+
+	constexpr uint32_t kOrbVertSpv[] =
+	{
+#include "generated/orb.vert.inc"
+	};
+
+	constexpr uint32_t kOrbFragSpv[] =
+	{
+#include "generated/orb.frag.inc"
+	};
+
+	struct EmbeddedShader
+	{
+		const char* name;
+		const uint32_t* code;
+		size_t size;
+	};
+
+	constexpr EmbeddedShader kEmbeddedShaders[] =
+	{
+		{ "shader.vert", kShaderVertSpv, sizeof(kShaderVertSpv) },
+		{ "shader.frag", kShaderFragSpv, sizeof(kShaderFragSpv) },
+		{ "waterfall.vert", kWaterfallVertSpv, sizeof(kWaterfallVertSpv) },
+		{ "waterfall.frag", kWaterfallFragSpv, sizeof(kWaterfallFragSpv) },
+		{ "chart.comp", kChartCompSpv, sizeof(kChartCompSpv) },
+		{ "fft.comp", kFFTCompSpv, sizeof(kFFTCompSpv) },
+		{ "orb.vert", kOrbVertSpv, sizeof(kOrbVertSpv) },
+		{ "orb.frag", kOrbFragSpv, sizeof(kOrbFragSpv) },
+	};
+	static_assert(sizeof(kEmbeddedShaders) / sizeof(kEmbeddedShaders[0]) == (size_t)ShaderId::Count, "every ShaderId needs an embedded shader");
+
+	constexpr uint32_t kSpirvMagic = 0x07230203;
+
+	std::string GetOverrideDirectory()
+	{
+		std::string dir;
+		char* value = nullptr;
+		size_t len = 0;
+		if (_dupenv_s(&value, &len, "WINORB_SHADER_DIR") == 0 && value != nullptr)
+		{
+			dir = value;
+			free(value);
+		}
+		return dir;
+	}
+
+	//loads <dir>/<name>.spv into storage, storage has to outlive the returned ShaderCode
+	bool LoadOverride(const std::string& dir, const char* name, std::vector<uint32_t>& storage)
+	{
+		std::vector<char> bytes;
+		std::string path = dir + "/" + name + ".spv";
+		if (!tryreadfile(path, bytes))
+			return false;
+
+		if (bytes.size() < sizeof(uint32_t) || bytes.size() % sizeof(uint32_t) != 0)
+		{
+			fprintf(stderr, "shader override %s is not valid SPIR-V, using the embedded one\n", path.c_str());
+			return false;
+		}
+
+		storage.resize(bytes.size() / sizeof(uint32_t));
+		memcpy(storage.data(), bytes.data(), bytes.size());
+		if (storage[0] != kSpirvMagic)
+		{
+			fprintf(stderr, "shader override %s is not valid SPIR-V, using the embedded one\n", path.c_str());
+			storage.clear();
+			return false;
+		}
+		fprintf(stderr, "using shader override %s\n", path.c_str());
+		return true;
+	}
+}
+
+ShaderCode GetShaderCode(ShaderId id)
+{
+	const EmbeddedShader& embedded = kEmbeddedShaders[(size_t)id];
+
+	static const std::string overrideDir = GetOverrideDirectory();
+	if (!overrideDir.empty())
+	{
+		static std::vector<uint32_t> overrides[(size_t)ShaderId::Count];
+		std::vector<uint32_t>& storage = overrides[(size_t)id];
+		if (storage.empty())
+			LoadOverride(overrideDir, embedded.name, storage);
+		if (!storage.empty())
+			return { storage.data(), storage.size() * sizeof(uint32_t) };
+	}
+
+	return { embedded.code, embedded.size };
+}
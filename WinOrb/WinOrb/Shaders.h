@@ -0,0 +1,32 @@
+#ifndef WINORB_SHADERS_H
+#define WINORB_SHADERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//every shader in /shaders gets compiled to SPIR-V at build time and baked into the exe,
+//so there's no more "run it from the right folder" nonsense
+enum class ShaderId
+{
+	ShaderVert,
+	ShaderFrag,
+	WaterfallVert,
+	WaterfallFrag,
+	ChartComp,
+	FFTComp,
+	OrbVert,
+	OrbFrag,
+	Count
+};
+
+struct ShaderCode
+{
+	const uint32_t* code;
+	size_t size; //in bytes, like VkShaderModuleCreateInfo wants
+};
+
+//returns the embedded SPIR-V, unless WINORB_SHADER_DIR is set and has a <name>.spv in it,
+//in which case that one wins (handy for iterating on shaders without rebuilding)
+ShaderCode GetShaderCode(ShaderId id);
+
+#endif //!WINORB_SHADERS_H
@@ -0,0 +1,114 @@
+#include "SpectrumPublisher.h"
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+bool SpectrumPublisher::Open()
+{
+	Close();
+	//two writers would tear each other's frames. the mapping existing says nothing, a reader can keep it alive
+	//long after its publisher is gone, so the mutex decides. abandoned means the last one crashed, it's ours now.
+	//a reader checking whether anyone's publishing holds it for a moment, hence not giving up straight away
+	HANDLE lock = CreateMutexW(NULL, FALSE, WINORB_SPECTRUM_SHM_WRITER_NAME);
+	if (lock == NULL)
+	{
+		fprintf(stderr, "couldn't create the spectrum writer mutex (%lu)\n", GetLastError());
+		return false;
+	}
+	DWORD wait = WaitForSingleObject(lock, 100);
+	if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+	{
+		fprintf(stderr, "another WinOrb is already publishing spectra, not publishing from this one\n");
+		CloseHandle(lock);
+		return false;
+	}
+	mWriterLock = lock;
+
+	//backed by the page file, goes away with the last process that has it mapped
+	const uint64_t size = sizeof(SpectrumShmHeader);
+	HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, WINORB_SPECTRUM_SHM_NAME);
+	if (mapping == NULL)
+	{
+		fprintf(stderr, "couldn't create the spectrum shared memory (%lu)\n", GetLastError());
+		Close();
+		return false;
+	}
+	bool takeover = GetLastError() == ERROR_ALREADY_EXISTS;
+	//an older WinOrb's mapping can be smaller than this one, then this fails until its readers let go
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+	if (view == nullptr)
+	{
+		fprintf(stderr, "couldn't map the spectrum shared memory (%lu)\n", GetLastError());
+		CloseHandle(mapping);
+		Close();
+		return false;
+	}
+
+	mMapping = mapping;
+	mHeader = (SpectrumShmHeader*)view;
+	//fresh page file mappings come zeroed, so every sequence starts at 0 (never written). one left behind by
+	//the last publisher gets its magic pulled first so nobody opens it halfway through, then every slot goes back
+	//to never written. published keeps counting, frame numbers only ever go up for whoever's reading
+	if (takeover)
+	{
+		mHeader->magic = 0;
+		std::atomic_thread_fence(std::memory_order_release);
+		for (SpectrumShmSlot& slot : mHeader->slot)
+			slot.sequence.store(0, std::memory_order_relaxed);
+		fprintf(stderr, "took over the spectrum shared memory a previous WinOrb left behind\n");
+	}
+	mHeader->generation.fetch_add(1, std::memory_order_release);
+	mHeader->version = kSpectrumShmVersion;
+	mHeader->slots = kSpectrumShmSlots;
+	mHeader->maxBins = kSpectrumShmMaxBins;
+	//magic last, readers check it before anything else
+	std::atomic_thread_fence(std::memory_order_release);
+	mHeader->magic = kSpectrumShmMagic;
+	return true;
+}
+
+void SpectrumPublisher::Close()
+{
+	if (mHeader != nullptr)
+	{
+		UnmapViewOfFile(mHeader);
+		mHeader = nullptr;
+	}
+	if (mMapping != nullptr)
+	{
+		CloseHandle((HANDLE)mMapping);
+		mMapping = nullptr;
+	}
+	if (mWriterLock != nullptr)
+	{
+		ReleaseMutex((HANDLE)mWriterLock);
+		CloseHandle((HANDLE)mWriterLock);
+		mWriterLock = nullptr;
+	}
+}
+
+void SpectrumPublisher::Publish(const float* magnitudes, uint32_t bins, uint32_t sampleRate, uint32_t fftSize, std::chrono::steady_clock::time_point captured, const RhythmState& rhythm)
+{
+	if (mHeader == nullptr)
+		return;
+	uint64_t frame = mHeader->published.load(std::memory_order_relaxed);
+	SpectrumShmSlot& slot = mHeader->slot[frame % kSpectrumShmSlots];
+	bins = std::min(bins, kSpectrumShmMaxBins);
+
+	//odd while writing, the fence keeps the payload stores from moving up above it
+	slot.sequence.store(frame * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.frame = frame;
+	slot.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(captured.time_since_epoch()).count();
+	slot.sampleRate = sampleRate;
+	slot.fftSize = fftSize;
+	slot.bins = bins;
+	slot.onsets = rhythm.onsets;
+	slot.beats = rhythm.beats;
+	slot.bpm = rhythm.bpm;
+	slot.beatPhase = rhythm.beatPhase;
+	memcpy(slot.magnitudes, magnitudes, bins * sizeof(float));
+	slot.sequence.store(frame * 2 + 2, std::memory_order_release);
+	mHeader->published.store(frame + 1, std::memory_order_release);
+}
@@ -0,0 +1,24 @@
+#ifndef WINORB_SPECTRUM_PUBLISHER_H
+#define WINORB_SPECTRUM_PUBLISHER_H
+
+#include "SpectrumShm.h"
+#include "BeatTracker.h"
+#include <chrono>
+
+//writes every analyzed frame into the WinOrbSpectrum shared memory ring, see SpectrumShm.h
+//one thread publishes, any number of processes read through SpectrumReader, nobody ever waits on anybody
+class SpectrumPublisher
+{
+public:
+	~SpectrumPublisher() { Close(); };
+	bool Open();
+	void Close();
+	void Publish(const float* magnitudes, uint32_t bins, uint32_t sampleRate, uint32_t fftSize, std::chrono::steady_clock::time_point captured, const RhythmState& rhythm);
+	uint64_t Published() const { return mHeader != nullptr ? mHeader->published.load(std::memory_order_relaxed) : 0; };
+private:
+	void* mWriterLock = nullptr; //HANDLE, the WinOrbSpectrumWriter mutex, held while open
+	void* mMapping = nullptr; //HANDLE
+	SpectrumShmHeader* mHeader = nullptr;
+};
+
+#endif //!WINORB_SPECTRUM_PUBLISHER_H
@@ -0,0 +1,350 @@
+#include "SpectrumPyramid.h"
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	uint8_t ToByte(float level)
+	{
+		return (uint8_t)(std::min(std::max(level, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+bool SpectrumPyramidBuilder::Open(const char* path)
+{
+	Close();
+	if (fopen_s(&mFile, path, "wb") != 0)
+	{
+		fprintf(stderr, "couldn't open %s for the recording's pyramid\n", path);
+		mFile = nullptr;
+		return false;
+	}
+	setvbuf(mFile, nullptr, _IOFBF, 1 << 16);
+	mLevels.clear();
+	mLevels.resize(1);
+	mIndex.clear();
+	mColumnMax.resize(kPyramidColumns);
+	mColumnSum.resize(kPyramidColumns);
+
+	PyramidFileHeader header = {};
+	header.magic = kPyramidMagic;
+	header.version = kPyramidVersion;
+	header.columns = kPyramidColumns;
+	header.baseFrames = kPyramidBaseFrames;
+	header.rowsPerBlock = kPyramidRowsPerBlock;
+	fwrite(&header, sizeof(header), 1, mFile);
+	mOffset = sizeof(header);
+	return true;
+}
+
+void SpectrumPyramidBuilder::Close()
+{
+	if (mFile == nullptr)
+		return;
+	//the leftovers at the end of every level go out as short rows, up to the first level that's down to a single row
+	for (size_t level = 0; level < mLevels.size(); ++level)
+	{
+		if (level > 0 && mLevels[level - 1].rows <= 1)
+			break;
+		if (mLevels[level].pending.frames > 0)
+			Emit(level);
+	}
+	for (size_t level = 0; level < mLevels.size(); ++level)
+		FlushBlock(level);
+
+	PyramidTrailer trailer = {};
+	trailer.indexOffset = mOffset;
+	trailer.blockCount = (uint32_t)mIndex.size();
+	trailer.magic = kPyramidIndexMagic;
+	if (!mIndex.empty())
+		fwrite(mIndex.data(), sizeof(PyramidIndexEntry), mIndex.size(), mFile);
+	fwrite(&trailer, sizeof(trailer), 1, mFile);
+	fclose(mFile);
+	mFile = nullptr;
+}
+
+void SpectrumPyramidBuilder::Append(const float* levels, uint32_t bins, int64_t us)
+{
+	if (mFile == nullptr || bins == 0)
+		return;
+	//fewer bars than columns repeats bars, more takes the max/mean of the bars under each column
+	for (uint32_t c = 0; c < kPyramidColumns; ++c)
+	{
+		uint32_t first = (uint32_t)((uint64_t)c * bins / kPyramidColumns);
+		uint32_t last = std::max(first + 1, (uint32_t)((uint64_t)(c + 1) * bins / kPyramidColumns));
+		float max = levels[first];
+		float sum = 0.0f;
+		for (uint32_t i = first; i < last; ++i)
+		{
+			max = std::max(max, levels[i]);
+			sum += levels[i];
+		}
+		mColumnMax[c] = max;
+		mColumnSum[c] = sum / (last - first);
+	}
+	Merge(mLevels[0].pending, mColumnMax, mColumnSum, 1, us, us);
+	if (mLevels[0].pending.frames >= kPyramidBaseFrames)
+		Emit(0);
+}
+
+void SpectrumPyramidBuilder::Merge(Accumulator& into, const std::vector<float>& max, const std::vector<float>& sum, uint32_t frames, int64_t startus, int64_t endus)
+{
+	if (into.frames == 0)
+	{
+		into.max = max;
+		into.sum = sum;
+		into.startUs = startus;
+	}
+	else
+	{
+		for (size_t c = 0; c < max.size(); ++c)
+		{
+			into.max[c] = std::max(into.max[c], max[c]);
+			into.sum[c] += sum[c];
+		}
+	}
+	into.frames += frames;
+	into.endUs = endus;
+}
+
+void SpectrumPyramidBuilder::Emit(size_t level)
+{
+	//before taking any references, this can move the levels around
+	if (mLevels.size() <= level + 1)
+		mLevels.resize(level + 2);
+	Level& current = mLevels[level];
+	Accumulator& row = current.pending;
+
+	PyramidRowHeader header = {};
+	header.startUs = row.startUs;
+	header.endUs = row.endUs;
+	header.frames = row.frames;
+	size_t at = current.block.size();
+	current.block.resize(at + sizeof(header) + 2 * kPyramidColumns);
+	uint8_t* out = current.block.data() + at;
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	for (uint32_t c = 0; c < kPyramidColumns; ++c)
+	{
+		out[c] = ToByte(row.max[c]);
+		out[kPyramidColumns + c] = ToByte(row.sum[c] / row.frames);
+	}
+	++current.rows;
+	++current.blockRows;
+	if (current.blockRows >= kPyramidRowsPerBlock)
+		FlushBlock(level);
+
+	Level& up = mLevels[level + 1];
+	Merge(up.pending, row.max, row.sum, row.frames, row.startUs, row.endUs);
+	++up.pending.children;
+	row.frames = 0;
+	row.children = 0;
+	if (up.pending.children >= 2)
+		Emit(level + 1);
+}
+
+void SpectrumPyramidBuilder::FlushBlock(size_t level)
+{
+	Level& current = mLevels[level];
+	if (current.blockRows == 0)
+		return;
+	PyramidBlockHeader header = {};
+	header.magic = kPyramidBlockMagic;
+	header.level = (uint32_t)level;
+	header.rows = current.blockRows;
+	header.firstRow = current.rows - current.blockRows;
+	PyramidIndexEntry entry = {};
+	entry.level = header.level;
+	entry.rows = header.rows;
+	entry.firstRow = header.firstRow;
+	entry.offset = mOffset;
+	mIndex.push_back(entry);
+
+	fwrite(&header, sizeof(header), 1, mFile);
+	fwrite(current.block.data(), 1, current.block.size(), mFile);
+	mOffset += sizeof(header) + current.block.size();
+	current.block.clear();
+	current.blockRows = 0;
+}
+
+bool SpectrumPyramidReader::Open(const char* path)
+{
+	Close();
+	if (!mFile.Open(path))
+		return false;
+	mData = mFile.Data();
+	mSize = mFile.Size();
+	mHeader = (const PyramidFileHeader*)mData;
+	if (mSize < sizeof(PyramidFileHeader) || mHeader->magic != kPyramidMagic || mHeader->version != kPyramidVersion || mHeader->columns == 0)
+	{
+		Close();
+		return false;
+	}
+	mRowStride = sizeof(PyramidRowHeader) + 2 * (size_t)mHeader->columns;
+
+	std::vector<PyramidIndexEntry> entries;
+	bool indexed = false;
+	if (mSize >= sizeof(PyramidFileHeader) + sizeof(PyramidTrailer))
+	{
+		PyramidTrailer trailer;
+		memcpy(&trailer, mData + mSize - sizeof(trailer), sizeof(trailer));
+		uint64_t indexbytes = (uint64_t)trailer.blockCount * sizeof(PyramidIndexEntry);
+		if (trailer.magic == kPyramidIndexMagic && trailer.indexOffset >= sizeof(PyramidFileHeader)
+			&& trailer.indexOffset + indexbytes + sizeof(trailer) == mSize)
+		{
+			entries.resize(trailer.blockCount);
+			if (!entries.empty())
+				memcpy(entries.data(), mData + trailer.indexOffset, indexbytes);
+			indexed = true;
+		}
+	}
+	if (!indexed)
+	{
+		//never got closed, the blocks that made it to disk are still good
+		uint64_t offset = sizeof(PyramidFileHeader);
+		while (offset + sizeof(PyramidBlockHeader) <= mSize)
+		{
+			PyramidBlockHeader block;
+			memcpy(&block, mData + offset, sizeof(block));
+			uint64_t bytes = sizeof(block) + (uint64_t)block.rows * mRowStride;
+			if (block.magic != kPyramidBlockMagic || offset + bytes > mSize)
+				break;
+			PyramidIndexEntry entry = {};
+			entry.level = block.level;
+			entry.rows = block.rows;
+			entry.firstRow = block.firstRow;
+			entry.offset = offset;
+			entries.push_back(entry);
+			offset += bytes;
+		}
+	}
+
+	for (const PyramidIndexEntry& entry : entries)
+	{
+		if (entry.level >= 64 || entry.rows == 0 || entry.offset + sizeof(PyramidBlockHeader) + (uint64_t)entry.rows * mRowStride > mSize)
+			continue;
+		if (mLevels.size() <= entry.level)
+			mLevels.resize(entry.level + 1);
+		mLevels[entry.level].push_back(entry);
+	}
+	for (std::vector<PyramidIndexEntry>& blocks : mLevels)
+	{
+		std::sort(blocks.begin(), blocks.end(), [](const PyramidIndexEntry& a, const PyramidIndexEntry& b) { return a.firstRow < b.firstRow; });
+	}
+	//a level with a hole in it (cut off mid write) is only good up to the hole, an empty one ends the pyramid
+	for (size_t level = 0; level < mLevels.size(); ++level)
+	{
+		std::vector<PyramidIndexEntry>& blocks = mLevels[level];
+		uint64_t next = 0;
+		size_t good = 0;
+		while (good < blocks.size() && blocks[good].firstRow == next)
+			next += blocks[good++].rows;
+		blocks.resize(good);
+		if (blocks.empty())
+		{
+			mLevels.resize(level);
+			break;
+		}
+	}
+	return true;
+}
+
+void SpectrumPyramidReader::Close()
+{
+	mFile.Close();
+	mData = nullptr;
+	mSize = 0;
+	mHeader = nullptr;
+	mLevels.clear();
+}
+
+uint64_t SpectrumPyramidReader::RowCount(size_t level) const
+{
+	if (level >= mLevels.size())
+		return 0;
+	const PyramidIndexEntry& last = mLevels[level].back();
+	return last.firstRow + last.rows;
+}
+
+const PyramidRowHeader* SpectrumPyramidReader::Row(size_t level, uint64_t row) const
+{
+	if (level >= mLevels.size())
+		return nullptr;
+	const std::vector<PyramidIndexEntry>& blocks = mLevels[level];
+	auto it = std::upper_bound(blocks.begin(), blocks.end(), row, [](uint64_t r, const PyramidIndexEntry& e) { return r < e.firstRow; });
+	if (it == blocks.begin())
+		return nullptr;
+	--it;
+	if (row >= it->firstRow + it->rows)
+		return nullptr;
+	return (const PyramidRowHeader*)(mData + it->offset + sizeof(PyramidBlockHeader) + (row - it->firstRow) * mRowStride);
+}
+
+uint64_t SpectrumPyramidReader::RowAt(size_t level, int64_t us) const
+{
+	uint64_t lo = 0;
+	uint64_t hi = RowCount(level);
+	while (hi - lo > 1)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+		if (Row(level, mid)->startUs <= us)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+bool SpectrumPyramidReader::Fetch(int64_t startus, int64_t endus, uint32_t pixels, std::vector<uint8_t>& max, std::vector<uint8_t>& mean, uint64_t* rowsread) const
+{
+	if (mHeader == nullptr || mLevels.empty() || pixels == 0 || endus < startus)
+		return false;
+	const uint32_t columns = mHeader->columns;
+
+	//the coarsest level with rows no longer than a pixel, the first row is always a full one
+	const int64_t span = endus - startus + 1;
+	size_t level = mLevels.size() - 1;
+	while (level > 0 && (Row(level, 0)->endUs - Row(level, 0)->startUs) * pixels > span)
+		--level;
+
+	max.assign((size_t)pixels * columns, 0);
+	mean.assign((size_t)pixels * columns, 0);
+	std::vector<uint64_t> sum(columns);
+	uint64_t read = 0;
+	for (uint32_t p = 0; p < pixels; ++p)
+	{
+		int64_t from = startus + span * p / pixels;
+		int64_t to = std::max(from, startus + span * (p + 1) / pixels - 1);
+		uint64_t first = RowAt(level, from);
+		uint64_t last = RowAt(level, to);
+		//the row before a gap in the recording doesn't reach into this pixel
+		if (Row(level, first)->endUs < from)
+			++first;
+
+		uint8_t* pixelmax = max.data() + (size_t)p * columns;
+		std::fill(sum.begin(), sum.end(), 0);
+		uint32_t frames = 0;
+		for (uint64_t r = first; r <= last; ++r)
+		{
+			const PyramidRowHeader* row = Row(level, r);
+			const uint8_t* rowmax = (const uint8_t*)(row + 1);
+			const uint8_t* rowmean = rowmax + columns;
+			for (uint32_t c = 0; c < columns; ++c)
+			{
+				pixelmax[c] = std::max(pixelmax[c], rowmax[c]);
+				sum[c] += rowmean[c] * row->frames;
+			}
+			frames += row->frames;
+			++read;
+		}
+		if (frames > 0)
+		{
+			uint8_t* pixelmean = mean.data() + (size_t)p * columns;
+			for (uint32_t c = 0; c < columns; ++c)
+				pixelmean[c] = (uint8_t)((sum[c] + frames / 2) / frames);
+		}
+	}
+	if (rowsread != nullptr)
+		*rowsread = read;
+	return true;
+}
@@ -0,0 +1,129 @@
+#ifndef WINORB_SPECTRUM_PYRAMID_H
+#define WINORB_SPECTRUM_PYRAMID_H
+
+#include "File.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+//.wos.pyr, the zoom-out pyramid next to a spectrum recording: per column max and mean of the chart levels over
+//kPyramidBaseFrames frames at level 0, twice as many at every level up, built while recording. a view of any
+//time range at screen width then only reads about one row per pixel from the level that fits, instead of
+//decoding every frame. below level 0 the recording itself is cheap enough, that's at most kPyramidBaseFrames
+//frames per pixel
+//
+//rows go out in blocks of kPyramidRowsPerBlock per level as they fill up, an index of the blocks at the end
+const uint32_t kPyramidMagic = 0x59504f57; //"WOPY"
+const uint32_t kPyramidBlockMagic = 0x42504f57; //"WOPB"
+const uint32_t kPyramidIndexMagic = 0x49504f57; //"WOPI"
+const uint32_t kPyramidVersion = 1;
+const uint32_t kPyramidColumns = 1024; //across, whatever the bar count, each column is the max/mean of its bars
+const uint32_t kPyramidBaseFrames = 16;
+const uint32_t kPyramidRowsPerBlock = 64;
+
+struct PyramidFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t columns;
+	uint32_t baseFrames;
+	uint32_t rowsPerBlock;
+	uint32_t pad[3];
+};
+
+//followed by rows of PyramidRowHeader + columns max levels + columns mean levels, 8 bit
+struct PyramidBlockHeader
+{
+	uint32_t magic;
+	uint32_t level;
+	uint32_t rows;
+	uint32_t pad;
+	uint64_t firstRow;
+};
+
+struct PyramidRowHeader
+{
+	int64_t startUs; //first frame
+	int64_t endUs; //last frame
+	uint32_t frames; //the full 2^level * baseFrames except at the end of the recording
+	uint32_t pad;
+};
+
+struct PyramidIndexEntry
+{
+	uint32_t level;
+	uint32_t rows;
+	uint64_t firstRow;
+	uint64_t offset; //of the block header
+};
+
+struct PyramidTrailer
+{
+	uint64_t indexOffset;
+	uint32_t blockCount;
+	uint32_t magic;
+};
+
+//fed every frame by SpectrumRecorder, a row per level gets finished every time enough frames came in
+class SpectrumPyramidBuilder
+{
+public:
+	~SpectrumPyramidBuilder() { Close(); };
+	bool Open(const char* path);
+	void Close(); //finishes the partial rows at the end of every level and writes the index
+	void Append(const float* levels, uint32_t bins, int64_t us);
+private:
+	struct Accumulator
+	{
+		std::vector<float> max;
+		std::vector<float> sum; //mean * frames, so rows of different sizes merge right
+		uint32_t frames = 0;
+		uint32_t children = 0; //rows merged in from the level below
+		int64_t startUs = 0;
+		int64_t endUs = 0;
+	};
+	struct Level
+	{
+		Accumulator pending;
+		uint64_t rows = 0; //finished
+		std::vector<uint8_t> block; //rows not written yet
+		uint32_t blockRows = 0;
+	};
+	void Emit(size_t level); //finishes level's pending row, writes it and merges it into the level above
+	void Merge(Accumulator& into, const std::vector<float>& max, const std::vector<float>& sum, uint32_t frames, int64_t startus, int64_t endus);
+	void FlushBlock(size_t level);
+
+	FILE* mFile = nullptr;
+	uint64_t mOffset = 0;
+	std::vector<Level> mLevels;
+	std::vector<float> mColumnMax; //scratch for one frame squeezed into kPyramidColumns
+	std::vector<float> mColumnSum;
+	std::vector<PyramidIndexEntry> mIndex;
+};
+
+//maps the pyramid and hands out rows straight from the mapping
+class SpectrumPyramidReader
+{
+public:
+	~SpectrumPyramidReader() { Close(); };
+	bool Open(const char* path);
+	void Close();
+	uint32_t Columns() const { return mHeader != nullptr ? mHeader->columns : 0; };
+	size_t LevelCount() const { return mLevels.size(); };
+	uint64_t RowCount(size_t level) const;
+	//the header, then Columns() max levels and Columns() mean levels
+	const PyramidRowHeader* Row(size_t level, uint64_t row) const;
+	//[startus, endus] squeezed into pixels rows of Columns() max and mean levels each (0 to 255 for the chart's 0 to 1),
+	//off the coarsest level whose rows still fit in a pixel
+	bool Fetch(int64_t startus, int64_t endus, uint32_t pixels, std::vector<uint8_t>& max, std::vector<uint8_t>& mean, uint64_t* rowsread = nullptr) const;
+private:
+	uint64_t RowAt(size_t level, int64_t us) const; //the last row starting at or before us
+	MappedFile mFile;
+	const uint8_t* mData = nullptr;
+	uint64_t mSize = 0;
+	const PyramidFileHeader* mHeader = nullptr;
+	size_t mRowStride = 0;
+	std::vector<std::vector<PyramidIndexEntry>> mLevels; //blocks per level, in row order
+};
+
+#endif //!WINORB_SPECTRUM_PYRAMID_H
@@ -0,0 +1,103 @@
+#include "SpectrumReader.h"
+#include <windows.h>
+
+bool SpectrumReader::Open()
+{
+	Close();
+	HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, WINORB_SPECTRUM_SHM_NAME);
+	if (mapping == NULL)
+		return false;
+	const SpectrumShmHeader* header = (const SpectrumShmHeader*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(SpectrumShmHeader));
+	if (header == nullptr)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+	//the publisher writes the magic last, anything else means it isn't set up yet or it's some other version
+	bool ok = header->magic == kSpectrumShmMagic;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	ok = ok && header->version == kSpectrumShmVersion && header->slots == kSpectrumShmSlots && header->maxBins == kSpectrumShmMaxBins;
+	if (!ok)
+	{
+		UnmapViewOfFile(header);
+		CloseHandle(mapping);
+		return false;
+	}
+	mMapping = mapping;
+	mHeader = header;
+	mGeneration = header->generation.load(std::memory_order_acquire);
+	return true;
+}
+
+void SpectrumReader::Close()
+{
+	if (mHeader != nullptr)
+	{
+		UnmapViewOfFile(mHeader);
+		mHeader = nullptr;
+	}
+	if (mMapping != nullptr)
+	{
+		CloseHandle((HANDLE)mMapping);
+		mMapping = nullptr;
+	}
+}
+
+bool SpectrumReader::Latest(SpectrumView& view, uint64_t after) const
+{
+	if (mHeader == nullptr)
+		return false;
+	//a couple of tries, the writer can lap the slot between reading published and the slot's sequence
+	for (int attempt = 0; attempt < 4; ++attempt)
+	{
+		uint64_t published = mHeader->published.load(std::memory_order_acquire);
+		if (published == 0 || published - 1 < after)
+			return false;
+		uint64_t frame = published - 1;
+		const SpectrumShmSlot& slot = mHeader->slot[frame % kSpectrumShmSlots];
+		uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != frame * 2 + 2)
+			continue;
+		view.frame = slot.frame;
+		view.timestampNs = slot.timestampNs;
+		view.sampleRate = slot.sampleRate;
+		view.fftSize = slot.fftSize;
+		view.bins = slot.bins < kSpectrumShmMaxBins ? slot.bins : kSpectrumShmMaxBins;
+		view.onsets = slot.onsets;
+		view.beats = slot.beats;
+		view.bpm = slot.bpm;
+		view.beatPhase = slot.beatPhase;
+		view.magnitudes = slot.magnitudes;
+		view.slot = &slot;
+		view.sequence = sequence;
+		if (StillValid(view))
+			return true;
+	}
+	return false;
+}
+
+bool SpectrumReader::StillValid(const SpectrumView& view) const
+{
+	if (view.slot == nullptr)
+		return false;
+	//keeps the reads of the payload from moving below the sequence check
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+bool SpectrumReader::Stale() const
+{
+	if (mHeader == nullptr)
+		return true;
+	if (mHeader->generation.load(std::memory_order_acquire) != mGeneration)
+		return true;
+	//the publisher holds the writer mutex for as long as it publishes, getting it means it's gone
+	HANDLE lock = OpenMutexW(SYNCHRONIZE, FALSE, WINORB_SPECTRUM_SHM_WRITER_NAME);
+	if (lock == NULL)
+		return true;
+	DWORD wait = WaitForSingleObject(lock, 0);
+	if (wait == WAIT_OBJECT_0 || wait == WAIT_ABANDONED)
+		ReleaseMutex(lock);
+	CloseHandle(lock);
+	return wait != WAIT_TIMEOUT;
+}
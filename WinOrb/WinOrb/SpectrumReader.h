@@ -0,0 +1,44 @@
+#ifndef WINORB_SPECTRUM_READER_H
+#define WINORB_SPECTRUM_READER_H
+
+#include "SpectrumShm.h"
+
+//a frame straight out of the shared memory, nothing gets copied. the magnitudes can get overwritten at any
+//point while reading them, so check StillValid once done with them and throw away what was read if it isn't
+struct SpectrumView
+{
+	uint64_t frame = 0;
+	int64_t timestampNs = 0;
+	uint32_t sampleRate = 0;
+	uint32_t fftSize = 0;
+	uint32_t bins = 0;
+	uint64_t onsets = 0;
+	uint64_t beats = 0;
+	float bpm = 0.0f;
+	float beatPhase = 0.0f;
+	const float* magnitudes = nullptr;
+	const SpectrumShmSlot* slot = nullptr;
+	uint64_t sequence = 0;
+};
+
+//the reading side of the WinOrbSpectrum shared memory, for tools that want WinOrb's spectra without their own capture
+class SpectrumReader
+{
+public:
+	~SpectrumReader() { Close(); };
+	bool Open(); //false while no WinOrb is publishing, just try again later
+	void Close();
+	bool IsOpen() const { return mHeader != nullptr; };
+	//the newest complete frame, false if there's nothing newer than after (pass the last view's frame + 1)
+	bool Latest(SpectrumView& view, uint64_t after = 0) const;
+	bool StillValid(const SpectrumView& view) const;
+	//true once another publisher took the mapping over or nobody's publishing anymore, Close and Open again then.
+	//a WinOrb idling through silence publishes nothing either, so only worth asking once frames stopped coming
+	bool Stale() const;
+private:
+	void* mMapping = nullptr; //HANDLE
+	const SpectrumShmHeader* mHeader = nullptr;
+	uint64_t mGeneration = 0; //as of Open
+};
+
+#endif //!WINORB_SPECTRUM_READER_H
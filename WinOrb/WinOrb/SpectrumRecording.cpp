@@ -0,0 +1,462 @@
+#include "SpectrumRecording.h"
+#include "ChartLevels.h"
+#include <string.h>
+#include <string>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	//rice codes longer than this switch to an escape (all ones) plus the raw value, deltas are at most 17 bits zigzagged
+	const uint32_t kRiceEscape = 24;
+	const uint32_t kRawBits = 17;
+
+	//bit index of the lowest set bit, val can't be 0
+	uint32_t LowestBit(uint64_t val)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, val);
+		return index;
+#else
+		return (uint32_t)__builtin_ctzll(val);
+#endif
+	}
+
+	uint32_t ZigZag(int32_t val) { return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31); }
+	int32_t UnZigZag(uint32_t val) { return (int32_t)(val >> 1) ^ -(int32_t)(val & 1); }
+
+	//lsb first into bytes
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<uint8_t>& out) : mOut(out) {};
+		void Write(uint32_t bits, uint32_t count)
+		{
+			mAcc |= (uint64_t)bits << mCount;
+			mCount += count;
+			while (mCount >= 8)
+			{
+				mOut.push_back((uint8_t)mAcc);
+				mAcc >>= 8;
+				mCount -= 8;
+			}
+		};
+		void Rice(uint32_t val, uint32_t k)
+		{
+			uint32_t quotient = val >> k;
+			if (quotient >= kRiceEscape)
+			{
+				Write((1u << kRiceEscape) - 1, kRiceEscape);
+				Write(val, kRawBits);
+				return;
+			}
+			//quotient ones and a zero
+			Write((1u << quotient) - 1, quotient + 1);
+			if (k > 0)
+				Write(val & ((1u << k) - 1), k);
+		};
+		void Align()
+		{
+			if (mCount > 0)
+				Write(0, 8 - mCount);
+		};
+	private:
+		std::vector<uint8_t>& mOut;
+		uint64_t mAcc = 0;
+		uint32_t mCount = 0;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {};
+		uint32_t Read(uint32_t count)
+		{
+			if (mCount < count)
+				Fill();
+			uint32_t val = (uint32_t)(mAcc & ((1ull << count) - 1));
+			mAcc >>= count;
+			mCount -= count;
+			return val;
+		};
+		uint32_t Rice(uint32_t k)
+		{
+			//the unary part in one go, the escape plus its terminating zero always fit in what Fill leaves
+			if (mCount < kRiceEscape + 1)
+				Fill();
+			uint64_t zeros = ~mAcc;
+			uint32_t quotient = zeros != 0 ? std::min(LowestBit(zeros), kRiceEscape) : kRiceEscape;
+			if (quotient == kRiceEscape)
+			{
+				mAcc >>= kRiceEscape;
+				mCount -= kRiceEscape;
+				return Read(kRawBits);
+			}
+			mAcc >>= quotient + 1;
+			mCount -= quotient + 1;
+			return (quotient << k) | (k > 0 ? Read(k) : 0);
+		};
+		//drops what's left of the current byte, hands back where the next whole byte starts
+		const uint8_t* Align()
+		{
+			const uint8_t* next = mData + std::min(mPos - mCount / 8, mSize);
+			mAcc = 0;
+			mCount = 0;
+			return next;
+		};
+	private:
+		//whole bytes until there's at least 57 bits, past the end reads zeros
+		void Fill()
+		{
+			while (mCount <= 56)
+			{
+				uint64_t byte = mPos < mSize ? mData[mPos] : 0;
+				++mPos;
+				mAcc |= byte << mCount;
+				mCount += 8;
+			}
+		};
+		const uint8_t* mData;
+		size_t mSize;
+		size_t mPos = 0;
+		uint64_t mAcc = 0;
+		uint32_t mCount = 0;
+	};
+
+	void WriteVarint(std::vector<uint8_t>& out, uint64_t val)
+	{
+		while (val >= 0x80)
+		{
+			out.push_back((uint8_t)(val | 0x80));
+			val >>= 7;
+		}
+		out.push_back((uint8_t)val);
+	}
+
+	const uint8_t* ReadVarint(const uint8_t* p, const uint8_t* end, uint64_t& val)
+	{
+		val = 0;
+		for (uint32_t shift = 0; p < end && shift < 64; shift += 7)
+		{
+			uint8_t byte = *p++;
+			val |= (uint64_t)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		return p;
+	}
+}
+
+bool SpectrumRecorder::Open(const char* path, uint32_t bits)
+{
+	Close();
+	if (fopen_s(&mFile, path, "wb") != 0)
+	{
+		fprintf(stderr, "couldn't open %s for recording\n", path);
+		mFile = nullptr;
+		return false;
+	}
+	//a chunk goes out in one go anyway, the buffer mostly batches the header and payload writes
+	setvbuf(mFile, nullptr, _IOFBF, 1 << 16);
+	mBits = bits == 16 ? 16 : 8;
+	mOffset = 0;
+	mFrames = 0;
+	mStarted = false;
+	mIndex.clear();
+	mChunk.frames = 0;
+
+	RecordingFileHeader header = {};
+	header.magic = kRecordingMagic;
+	header.version = kRecordingVersion;
+	header.bits = mBits;
+	header.startUnixUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	fwrite(&header, sizeof(header), 1, mFile);
+	mOffset += sizeof(header);
+	//the recording's fine without it, just slower to zoom out on
+	mPyramid.Open((std::string(path) + ".pyr").c_str());
+	return true;
+}
+
+void SpectrumRecorder::Close()
+{
+	if (mFile == nullptr)
+		return;
+	FlushChunk();
+	RecordingTrailer trailer = {};
+	trailer.indexOffset = mOffset;
+	trailer.chunkCount = (uint32_t)mIndex.size();
+	trailer.magic = kRecordingIndexMagic;
+	if (!mIndex.empty())
+		fwrite(mIndex.data(), sizeof(RecordingIndexEntry), mIndex.size(), mFile);
+	fwrite(&trailer, sizeof(trailer), 1, mFile);
+	fclose(mFile);
+	mFile = nullptr;
+	mPyramid.Close();
+}
+
+void SpectrumRecorder::Append(const float* magnitudes, uint32_t bins, uint32_t sampleRate, uint32_t fftSize, uint64_t collected, std::chrono::steady_clock::time_point captured)
+{
+	if (mFile == nullptr || bins == 0)
+		return;
+	if (!mStarted)
+	{
+		mStart = captured;
+		mStarted = true;
+	}
+	int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(captured - mStart).count();
+	us = std::max(us, mLastUs);
+
+	//anything that changes how the frame reads starts a new chunk
+	bool changed = mChunk.frames > 0 && (mChunk.bins != bins || mChunk.sampleRate != sampleRate || mChunk.fftSize != fftSize);
+	if (changed || mChunk.frames >= kFramesPerChunk)
+		FlushChunk();
+	if (mChunk.frames == 0)
+	{
+		mChunk = {};
+		mChunk.magic = kRecordingChunkMagic;
+		mChunk.bins = bins;
+		mChunk.sampleRate = sampleRate;
+		mChunk.fftSize = fftSize;
+		mChunk.startUs = us;
+		mChunk.firstFrame = mFrames;
+		mChunkFirstCollected = collected;
+		mPrevious.assign(bins, 0);
+		mPayload.clear();
+		mLastUs = us;
+	}
+
+	//same dB scale as the chart, quantized
+	mLevels.resize(bins);
+	ToChartLevels(magnitudes, mLevels.data(), bins);
+	const float steps = (float)((1u << mBits) - 1);
+
+	//the rice parameter that fits this frame's deltas, about log2 of the mean zigzagged delta
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < bins; ++i)
+	{
+		uint16_t quantized = (uint16_t)(mLevels[i] * steps + 0.5f);
+		int32_t delta = (int32_t)quantized - (int32_t)mPrevious[i];
+		sum += ZigZag(delta);
+	}
+	uint32_t k = 0;
+	while (k < 16 && ((uint64_t)bins << (k + 1)) <= sum)
+		++k;
+
+	WriteVarint(mPayload, (uint64_t)(us - mLastUs));
+	mPayload.push_back((uint8_t)k);
+	BitWriter bits(mPayload);
+	for (uint32_t i = 0; i < bins; ++i)
+	{
+		uint16_t quantized = (uint16_t)(mLevels[i] * steps + 0.5f);
+		bits.Rice(ZigZag((int32_t)quantized - (int32_t)mPrevious[i]), k);
+		mPrevious[i] = quantized;
+	}
+	bits.Align();
+	mPyramid.Append(mLevels.data(), bins, us);
+
+	mLastUs = us;
+	mChunkLastCollected = collected;
+	++mChunk.frames;
+	++mFrames;
+}
+
+void SpectrumRecorder::FlushChunk()
+{
+	if (mChunk.frames == 0)
+		return;
+	mChunk.payloadBytes = (uint32_t)mPayload.size();
+	mChunk.hop = mChunk.frames > 1 ? (uint32_t)((mChunkLastCollected - mChunkFirstCollected) / (mChunk.frames - 1)) : 0;
+
+	RecordingIndexEntry entry = {};
+	entry.startUs = mChunk.startUs;
+	entry.endUs = mLastUs;
+	entry.offset = mOffset;
+	entry.firstFrame = mChunk.firstFrame;
+	mIndex.push_back(entry);
+
+	fwrite(&mChunk, sizeof(mChunk), 1, mFile);
+	fwrite(mPayload.data(), 1, mPayload.size(), mFile);
+	mOffset += sizeof(mChunk) + mPayload.size();
+	mChunk.frames = 0;
+}
+
+bool SpectrumRecordingReader::Open(const char* path)
+{
+	Close();
+	if (!mFile.Open(path))
+		return false;
+	mData = mFile.Data();
+	mSize = mFile.Size();
+	if (mSize < sizeof(RecordingFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	mHeader = (const RecordingFileHeader*)mData;
+	if (mHeader->magic != kRecordingMagic || mHeader->version != kRecordingVersion)
+	{
+		Close();
+		return false;
+	}
+
+	//the index at the end when the recording got closed properly
+	bool indexed = false;
+	if (mSize >= sizeof(RecordingFileHeader) + sizeof(RecordingTrailer))
+	{
+		RecordingTrailer trailer;
+		memcpy(&trailer, mData + mSize - sizeof(trailer), sizeof(trailer));
+		uint64_t indexbytes = (uint64_t)trailer.chunkCount * sizeof(RecordingIndexEntry);
+		if (trailer.magic == kRecordingIndexMagic && trailer.indexOffset + indexbytes + sizeof(trailer) == mSize)
+		{
+			mIndex.resize(trailer.chunkCount);
+			if (indexbytes > 0)
+				memcpy(mIndex.data(), mData + trailer.indexOffset, (size_t)indexbytes);
+			indexed = true;
+		}
+	}
+	//otherwise walk the chunk headers, everything up to the first incomplete chunk is still good
+	if (!indexed)
+	{
+		uint64_t offset = sizeof(RecordingFileHeader);
+		while (offset + sizeof(RecordingChunkHeader) <= mSize)
+		{
+			RecordingChunkHeader chunk;
+			memcpy(&chunk, mData + offset, sizeof(chunk));
+			if (chunk.magic != kRecordingChunkMagic || offset + sizeof(chunk) + chunk.payloadBytes > mSize)
+				break;
+			RecordingIndexEntry entry = {};
+			entry.startUs = chunk.startUs;
+			entry.offset = offset;
+			entry.firstFrame = chunk.firstFrame;
+			//the end needs the frame times, only the last chunk's matters for the duration
+			entry.endUs = chunk.startUs;
+			mIndex.push_back(entry);
+			offset += sizeof(chunk) + chunk.payloadBytes;
+		}
+		if (!mIndex.empty() && StartChunk(mIndex.size() - 1))
+		{
+			while (DecodeNext())
+			{
+			}
+			if (mDecodedCount > 0)
+				mIndex.back().endUs = mDecoded[mDecodedCount - 1].timestampUs;
+		}
+	}
+	return true;
+}
+
+void SpectrumRecordingReader::Close()
+{
+	mFile.Close();
+	mData = nullptr;
+	mHeader = nullptr;
+	mSize = 0;
+	mIndex.clear();
+	mDecodedChunk = (size_t)-1;
+	mDecodedCount = 0;
+}
+
+uint64_t SpectrumRecordingReader::FrameCount() const
+{
+	if (mIndex.empty())
+		return 0;
+	RecordingChunkHeader last;
+	memcpy(&last, mData + mIndex.back().offset, sizeof(last));
+	return last.firstFrame + last.frames;
+}
+
+bool SpectrumRecordingReader::StartChunk(size_t chunk)
+{
+	if (chunk == mDecodedChunk)
+		return true;
+	if (chunk >= mIndex.size())
+		return false;
+	memcpy(&mChunk, mData + mIndex[chunk].offset, sizeof(mChunk));
+	mCursor = mData + mIndex[chunk].offset + sizeof(mChunk);
+	mChunkEnd = mCursor + mChunk.payloadBytes;
+	mCursorUs = mChunk.startUs;
+	mPrevious.assign(mChunk.bins, 0);
+	//vectors get reused from the last chunk, their levels only get resized
+	mDecoded.resize(mChunk.frames);
+	mDecodedCount = 0;
+	mDecodedChunk = chunk;
+	return true;
+}
+
+bool SpectrumRecordingReader::NextTimestamp(int64_t& us) const
+{
+	if (mDecodedCount >= mChunk.frames)
+		return false;
+	uint64_t delta = 0;
+	ReadVarint(mCursor, mChunkEnd, delta);
+	us = mCursorUs + (int64_t)delta;
+	return true;
+}
+
+bool SpectrumRecordingReader::DecodeNext()
+{
+	if (mDecodedCount >= mChunk.frames)
+		return false;
+	uint64_t delta = 0;
+	const uint8_t* p = ReadVarint(mCursor, mChunkEnd, delta);
+	if (p >= mChunkEnd)
+		return false;
+	uint32_t k = *p++;
+	mCursorUs += (int64_t)delta;
+
+	RecordedFrame& frame = mDecoded[mDecodedCount];
+	frame.timestampUs = mCursorUs;
+	frame.frame = mChunk.firstFrame + mDecodedCount;
+	frame.sampleRate = mChunk.sampleRate;
+	frame.hop = mChunk.hop;
+	frame.fftSize = mChunk.fftSize;
+	frame.levels.resize(mChunk.bins);
+	const float scale = 1.0f / (float)((1u << mHeader->bits) - 1);
+	BitReader bits(p, mChunkEnd - p);
+	for (uint32_t i = 0; i < mChunk.bins; ++i)
+	{
+		mPrevious[i] = (uint16_t)(mPrevious[i] + UnZigZag(bits.Rice(k)));
+		frame.levels[i] = mPrevious[i] * scale;
+	}
+	mCursor = bits.Align();
+	++mDecodedCount;
+	return true;
+}
+
+bool SpectrumRecordingReader::FrameAt(int64_t timestampus, RecordedFrame& frame)
+{
+	if (mIndex.empty())
+		return false;
+	//the last chunk starting at or before the timestamp
+	auto it = std::upper_bound(mIndex.begin(), mIndex.end(), timestampus, [](int64_t us, const RecordingIndexEntry& entry) { return us < entry.startUs; });
+	size_t chunk = it == mIndex.begin() ? 0 : (size_t)(it - mIndex.begin()) - 1;
+	if (!StartChunk(chunk))
+		return false;
+	//decode up to the last frame that isn't past the timestamp, the next frame's time sits in front of its data
+	int64_t next = 0;
+	while (mDecodedCount == 0 || (NextTimestamp(next) && next <= timestampus))
+	{
+		if (!DecodeNext())
+			break;
+	}
+	if (mDecodedCount == 0)
+		return false;
+	auto match = std::upper_bound(mDecoded.begin(), mDecoded.begin() + mDecodedCount, timestampus, [](int64_t us, const RecordedFrame& f) { return us < f.timestampUs; });
+	frame = match == mDecoded.begin() ? mDecoded.front() : *(match - 1);
+	return true;
+}
+
+bool SpectrumRecordingReader::ReadChunk(size_t chunk, std::vector<RecordedFrame>& frames)
+{
+	if (!StartChunk(chunk))
+		return false;
+	while (DecodeNext())
+	{
+	}
+	frames.assign(mDecoded.begin(), mDecoded.begin() + mDecodedCount);
+	return mDecodedCount == mChunk.frames;
+}
@@ -0,0 +1,144 @@
+#ifndef WINORB_SPECTRUM_RECORDING_H
+#define WINORB_SPECTRUM_RECORDING_H
+
+#include "File.h"
+#include "SpectrumPyramid.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+//.wos spectrum recordings: a file header, chunks of up to kFramesPerChunk frames, then an index of the chunks
+//and a trailer pointing at it. each chunk stands on its own (rate, hop, fft size, bins can change between
+//chunks), frames are the chart's dB levels quantized to 8 or 16 bits, delta coded against the previous frame
+//in the chunk and rice coded. all little endian
+const uint32_t kRecordingMagic = 0x52534f57; //"WOSR"
+const uint32_t kRecordingChunkMagic = 0x43534f57; //"WOSC"
+const uint32_t kRecordingIndexMagic = 0x49534f57; //"WOSI"
+const uint32_t kRecordingVersion = 1;
+
+struct RecordingFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t bits; //8 or 16
+	uint32_t pad;
+	int64_t startUnixUs; //wall clock when the recording started, every other timestamp is relative to it
+};
+
+//followed by payloadBytes of frames, each one: varint us since the previous frame (0 for the first), a byte
+//with the rice parameter, then bins rice coded zigzag deltas, padded to a whole byte
+struct RecordingChunkHeader
+{
+	uint32_t magic;
+	uint32_t frames;
+	uint32_t bins;
+	uint32_t sampleRate;
+	uint32_t hop; //average samples between frames, 0 if the chunk has a single frame
+	uint32_t fftSize;
+	uint32_t payloadBytes;
+	uint32_t pad;
+	int64_t startUs; //first frame
+	uint64_t firstFrame;
+};
+
+struct RecordingIndexEntry
+{
+	int64_t startUs;
+	int64_t endUs; //last frame
+	uint64_t offset; //of the chunk header
+	uint64_t firstFrame;
+};
+
+//at the very end of the file, behind chunkCount index entries
+struct RecordingTrailer
+{
+	uint64_t indexOffset;
+	uint32_t chunkCount;
+	uint32_t magic;
+};
+
+struct RecordedFrame
+{
+	int64_t timestampUs = 0;
+	uint64_t frame = 0;
+	uint32_t sampleRate = 0;
+	uint32_t hop = 0;
+	uint32_t fftSize = 0;
+	std::vector<float> levels; //chart levels in [0, 1], 150dB over the whole range like ToChartLevel
+};
+
+//writes frames as they come in, a chunk at a time, Close writes the index. without it (say a crash) the reader
+//falls back to walking the chunk headers
+class SpectrumRecorder
+{
+public:
+	static const uint32_t kFramesPerChunk = 64; //seeks decode half a chunk on average
+	~SpectrumRecorder() { Close(); };
+	bool Open(const char* path, uint32_t bits = 8);
+	void Close();
+	bool IsOpen() const { return mFile != nullptr; };
+	//collected is the capture's running sample count, only used to work out the hop
+	void Append(const float* magnitudes, uint32_t bins, uint32_t sampleRate, uint32_t fftSize, uint64_t collected, std::chrono::steady_clock::time_point captured);
+	uint64_t Frames() const { return mFrames; };
+	uint64_t BytesWritten() const { return mOffset; };
+private:
+	void FlushChunk();
+
+	FILE* mFile = nullptr;
+	uint32_t mBits = 8;
+	uint64_t mOffset = 0;
+	uint64_t mFrames = 0;
+	bool mStarted = false;
+	std::chrono::steady_clock::time_point mStart;
+	std::vector<float> mLevels;
+	std::vector<uint16_t> mPrevious; //last frame's quantized levels in the current chunk
+	std::vector<uint8_t> mPayload;
+	RecordingChunkHeader mChunk = {};
+	uint64_t mChunkFirstCollected = 0;
+	uint64_t mChunkLastCollected = 0;
+	int64_t mLastUs = 0;
+	std::vector<RecordingIndexEntry> mIndex;
+	SpectrumPyramidBuilder mPyramid; //<path>.pyr
+};
+
+//maps the whole file and finds chunks through the index, so seeking anywhere is a binary search plus
+//decoding at most one chunk
+class SpectrumRecordingReader
+{
+public:
+	~SpectrumRecordingReader() { Close(); };
+	bool Open(const char* path);
+	void Close();
+	uint32_t Bits() const { return mHeader != nullptr ? mHeader->bits : 0; };
+	int64_t StartUnixUs() const { return mHeader != nullptr ? mHeader->startUnixUs : 0; };
+	int64_t DurationUs() const { return mIndex.empty() ? 0 : mIndex.back().endUs; };
+	uint64_t FrameCount() const;
+	size_t ChunkCount() const { return mIndex.size(); };
+	const RecordingIndexEntry& Chunk(size_t i) const { return mIndex[i]; };
+	//the last frame at or before timestampus (the first one if it's before the start)
+	bool FrameAt(int64_t timestampus, RecordedFrame& frame);
+	//every frame of a chunk, in order
+	bool ReadChunk(size_t chunk, std::vector<RecordedFrame>& frames);
+private:
+	bool StartChunk(size_t chunk);
+	bool DecodeNext(); //one more frame of the current chunk, they only ever come out in order
+	bool NextTimestamp(int64_t& us) const; //of the frame DecodeNext would do, without decoding it
+	MappedFile mFile;
+	const uint8_t* mData = nullptr;
+	uint64_t mSize = 0;
+	const RecordingFileHeader* mHeader = nullptr;
+	std::vector<RecordingIndexEntry> mIndex;
+	//the chunk being decoded, only as far as anyone asked for. frames stay around, so sequential reads and
+	//seeks within the same chunk don't decode anything twice
+	size_t mDecodedChunk = (size_t)-1;
+	RecordingChunkHeader mChunk = {};
+	std::vector<RecordedFrame> mDecoded;
+	size_t mDecodedCount = 0;
+	const uint8_t* mCursor = nullptr;
+	const uint8_t* mChunkEnd = nullptr;
+	int64_t mCursorUs = 0;
+	std::vector<uint16_t> mPrevious;
+};
+
+#endif //!WINORB_SPECTRUM_RECORDING_H
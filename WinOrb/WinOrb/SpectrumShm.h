@@ -0,0 +1,57 @@
+#ifndef WINORB_SPECTRUM_SHM_H
+#define WINORB_SPECTRUM_SHM_H
+
+//the layout of the shared memory WinOrb publishes its spectra into, for other processes on the same box.
+//only needs the standard library, copy it along with SpectrumReader.h/.cpp into whatever wants to read it
+//
+//a ring of kSpectrumShmSlots frames, each slot guarded by its own seqlock: the sequence is odd while the
+//slot's being written and 2 * (frame + 1) once frame is complete. the writer never waits on anyone, a
+//reader that's too slow just sees the sequence change under it and tries again with a newer frame
+//
+//only one process writes, whoever holds the WinOrbSpectrumWriter mutex. a publisher that starts while readers still
+//hold the mapping of one that's gone takes it over, resets the slots and bumps the generation. readers that stop
+//getting frames check Stale on the reader and reopen
+#include <stdint.h>
+#include <atomic>
+
+#define WINORB_SPECTRUM_SHM_NAME L"Local\\WinOrbSpectrum"
+#define WINORB_SPECTRUM_SHM_WRITER_NAME L"Local\\WinOrbSpectrumWriter"
+
+const uint32_t kSpectrumShmMagic = 0x50534f57; //"WOSP"
+const uint32_t kSpectrumShmVersion = 3;
+const uint32_t kSpectrumShmSlots = 8;
+const uint32_t kSpectrumShmMaxBins = 32768; //AnalysisSettings::kMaxChartBins
+
+//plain 64 bit atomics are address free, so they work across processes mapping the same memory
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the seqlock needs lock-free 64 bit atomics");
+
+struct SpectrumShmSlot
+{
+	std::atomic<uint64_t> sequence;
+	uint64_t frame; //counts up from 0 for every published frame
+	int64_t timestampNs; //when the window got captured, steady_clock (QueryPerformanceCounter) so every process agrees
+	uint32_t sampleRate;
+	uint32_t fftSize;
+	uint32_t bins; //how many magnitudes are valid, linear from 0 to sampleRate / 2
+	uint32_t pad;
+	//the beat tracker as of this frame, the counts only go up so a reader that skipped frames can tell it missed some
+	uint64_t onsets;
+	uint64_t beats;
+	float bpm; //0 while it can't tell
+	float beatPhase; //0 on a beat up to 1 right before the next
+	float magnitudes[kSpectrumShmMaxBins]; //linear, scaled to what a 2048 point fft gives like everywhere else
+};
+
+struct SpectrumShmHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t maxBins;
+	std::atomic<uint64_t> published; //frames published so far, the newest one is published - 1
+	std::atomic<uint64_t> generation; //goes up every time a publisher takes over the mapping
+	uint64_t pad[4];
+	SpectrumShmSlot slot[kSpectrumShmSlots];
+};
+
+#endif //!WINORB_SPECTRUM_SHM_H
@@ -0,0 +1,42 @@
+#ifndef WINORB_SPSC_QUEUE_H
+#define WINORB_SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+//bounded lock-free single producer/single consumer ring, one thread only pushes, one other thread only pops.
+//holds at most Capacity - 1 items, the empty slot tells full from empty
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity has to be a power of two");
+public:
+	bool Push(const T& item) //false when full
+	{
+		size_t tail = mTail.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) & (Capacity - 1);
+		if (next == mHead.load(std::memory_order_acquire))
+			return false;
+		mItems[tail] = item;
+		mTail.store(next, std::memory_order_release);
+		return true;
+	};
+	bool Pop(T& item) //false when empty
+	{
+		size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return false;
+		item = mItems[head];
+		mHead.store((head + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	};
+	//only a hint from any other thread, exact from either end
+	bool Empty() const { return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire); };
+private:
+	T mItems[Capacity];
+	//own cache lines so the two ends don't keep stealing them from each other
+	alignas(64) std::atomic<size_t> mHead{ 0 };
+	alignas(64) std::atomic<size_t> mTail{ 0 };
+};
+
+#endif //!WINORB_SPSC_QUEUE_H
@@ -0,0 +1,198 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace
+{
+	//which queue belongs to the current thread, so submits from inside a task stay local
+	thread_local const ThreadPool* tPool = nullptr;
+	thread_local size_t tQueue = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	//the caller is one of the threads, it runs work whenever it waits
+	for (size_t i = 0; i + 1 < threads; ++i)
+		mQueues.emplace_back(new WorkerQueue());
+	for (size_t i = 0; i < mQueues.size(); ++i)
+		mThreads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+		mStop = true;
+	}
+	mSleep.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task, std::atomic<size_t>& pending)
+{
+	if (mQueues.empty())
+	{
+		task();
+		Finish(pending);
+		return;
+	}
+	size_t queue = tPool == this ? tQueue : mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+	{
+		//counted under the deque's lock, like the pop takes it back off, so it never runs below what's queued
+		std::lock_guard<std::mutex> lock(mQueues[queue]->lock);
+		mQueued.fetch_add(1, std::memory_order_release);
+		mQueues[queue]->tasks.push_back({ std::move(task), &pending });
+	}
+	//taking the lock makes sure a worker (or a Wait) that just saw nothing queued is actually waiting before the notify
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+	}
+	mSleep.notify_one();
+}
+
+bool ThreadPool::TryRun(size_t self)
+{
+	if (mQueued.load(std::memory_order_acquire) == 0)
+		return false;
+	Task task;
+	bool found = false;
+	const size_t count = mQueues.size();
+	//own queue from the back, it's the most recently pushed and still warm in cache
+	if (self < count)
+	{
+		std::lock_guard<std::mutex> lock(mQueues[self]->lock);
+		if (!mQueues[self]->tasks.empty())
+		{
+			task = std::move(mQueues[self]->tasks.back());
+			mQueues[self]->tasks.pop_back();
+			mQueued.fetch_sub(1, std::memory_order_relaxed);
+			found = true;
+		}
+	}
+	//then steal the oldest (usually the biggest chunk of remaining work) from everyone else
+	for (size_t i = 1; !found && i <= count; ++i)
+	{
+		size_t victim = (self + i) % count;
+		std::lock_guard<std::mutex> lock(mQueues[victim]->lock);
+		if (!mQueues[victim]->tasks.empty())
+		{
+			task = std::move(mQueues[victim]->tasks.front());
+			mQueues[victim]->tasks.pop_front();
+			mQueued.fetch_sub(1, std::memory_order_relaxed);
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+	task.fn();
+	Finish(*task.pending);
+	return true;
+}
+
+void ThreadPool::Finish(std::atomic<size_t>& pending)
+{
+	if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+	//the last one, wake whoever's blocked in Wait on it. same lock dance as Submit
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+	}
+	mSleep.notify_all();
+}
+
+void ThreadPool::WorkerLoop(size_t index)
+{
+	TRACE_THREAD("pool worker");
+	tPool = this;
+	tQueue = index;
+	while (true)
+	{
+		if (TryRun(index))
+			continue;
+		std::unique_lock<std::mutex> lock(mSleepLock);
+		mSleep.wait(lock, [this]() { return mStop || mQueued.load(std::memory_order_acquire) > 0; });
+		if (mStop)
+			return;
+	}
+}
+
+void ThreadPool::Wait(const std::atomic<size_t>& pending)
+{
+	size_t self = tPool == this ? tQueue : mQueues.size();
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		if (TryRun(self))
+			continue;
+		//whatever's left is running on other threads, sleep until it's done or there's new work to help with
+		//(a task still running might queue some, and this thread may be the only one free to run it)
+		std::unique_lock<std::mutex> lock(mSleepLock);
+		mSleep.wait(lock, [&]() { return pending.load(std::memory_order_acquire) == 0 || mQueued.load(std::memory_order_acquire) > 0; });
+	}
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (begin >= end)
+		return;
+	//a few chunks per thread so stealing can even out uneven chunks, but never smaller than grain
+	const size_t count = end - begin;
+	size_t chunk = std::max(std::max<size_t>(grain, 1), (count + ThreadCount() * 4 - 1) / (ThreadCount() * 4));
+	size_t chunks = (count + chunk - 1) / chunk;
+	if (chunks == 1 || mQueues.empty())
+	{
+		body(begin, end);
+		return;
+	}
+	std::atomic<size_t> pending(chunks - 1);
+	//the caller takes the first chunk itself
+	for (size_t i = 1; i < chunks; ++i)
+	{
+		size_t first = begin + i * chunk;
+		size_t last = std::min(end, first + chunk);
+		Submit([&body, first, last]() { body(first, last); }, pending);
+	}
+	body(begin, std::min(end, begin + chunk));
+	Wait(pending);
+}
+
+TaskGraph::TaskId TaskGraph::Add(std::function<void()> fn, const std::vector<TaskId>& dependencies)
+{
+	TaskId id = mNodes.size();
+	mNodes.emplace_back();
+	mNodes.back().fn = std::move(fn);
+	mNodes.back().dependencies = dependencies.size();
+	for (TaskId dependency : dependencies)
+		mNodes[dependency].successors.push_back(id);
+	return id;
+}
+
+void TaskGraph::Queue(ThreadPool& pool, TaskId id, std::atomic<size_t>& pending)
+{
+	pool.Submit([this, &pool, id, &pending]()
+	{
+		Node& node = mNodes[id];
+		node.fn();
+		for (TaskId successor : node.successors)
+		{
+			//the last dependency to finish queues it, counted before this task's own pending goes down
+			if (mNodes[successor].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				Queue(pool, successor, pending);
+		}
+	}, pending);
+}
+
+void TaskGraph::Run(ThreadPool& pool)
+{
+	std::atomic<size_t> pending(mNodes.size());
+	for (Node& node : mNodes)
+		node.remaining.store(node.dependencies, std::memory_order_relaxed);
+	for (TaskId id = 0; id < mNodes.size(); ++id)
+	{
+		if (mNodes[id].dependencies == 0)
+			Queue(pool, id, pending);
+	}
+	pool.Wait(pending);
+}
@@ -0,0 +1,77 @@
+#ifndef WINORB_THREAD_POOL_H
+#define WINORB_THREAD_POOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//work stealing pool for the offline/batch side of things: every worker has its own deque, pushes and pops
+//its own work at the back and steals from the front of everyone else's when it runs dry. whoever waits on
+//work helps run it and only blocks once there's nothing left to help with, so nesting (a parallel for inside a
+//task) can't deadlock
+class ThreadPool
+{
+public:
+	//threads counts the caller too, 1 runs everything inline on the caller. 0 is one per hardware thread
+	explicit ThreadPool(size_t threads = 0);
+	~ThreadPool();
+	size_t ThreadCount() const { return mQueues.size() + 1; };
+	//runs task on some thread, pending gets decremented once it's done. callers count pending up themselves
+	void Submit(std::function<void()> task, std::atomic<size_t>& pending);
+	//runs queued work (anyone's) until pending hits 0, sleeps while what's left is running elsewhere
+	void Wait(const std::atomic<size_t>& pending);
+	//body(first, last) over [begin, end) in chunks of at least grain, returns once all of them ran
+	void ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+private:
+	struct Task
+	{
+		std::function<void()> fn;
+		std::atomic<size_t>* pending;
+	};
+	//a mutex per deque, they're only ever contended when someone's stealing
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+	void WorkerLoop(size_t index);
+	bool TryRun(size_t self); //self is the caller's queue, or past the end for threads outside the pool
+	void Finish(std::atomic<size_t>& pending); //a task's done, wakes the waiters once pending hits 0
+
+	std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+	std::vector<std::thread> mThreads;
+	std::atomic<size_t> mQueued{ 0 }; //tasks sitting in the deques, only changes under one of their locks
+	std::atomic<size_t> mNextQueue{ 0 }; //round robin for submits from outside the pool
+	std::mutex mSleepLock;
+	std::condition_variable mSleep;
+	bool mStop = false;
+};
+
+//tasks with dependencies, built up front and then run on a pool. a task gets queued once everything it
+//depends on finished, Run returns once all of them did
+class TaskGraph
+{
+public:
+	typedef size_t TaskId;
+	TaskId Add(std::function<void()> fn, const std::vector<TaskId>& dependencies = {});
+	void Run(ThreadPool& pool);
+private:
+	struct Node
+	{
+		std::function<void()> fn;
+		std::vector<TaskId> successors;
+		size_t dependencies = 0;
+		std::atomic<size_t> remaining{ 0 };
+	};
+	void Queue(ThreadPool& pool, TaskId id, std::atomic<size_t>& pending);
+
+	std::deque<Node> mNodes; //deque so the atomics never move
+};
+
+#endif //!WINORB_THREAD_POOL_H
@@ -0,0 +1,162 @@
+#include "Trace.h"
+#include <stdio.h>
+#include <chrono>
+
+#ifdef WINORB_TRACE
+
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> gTracing(false);
+
+namespace
+{
+	struct TraceRecord
+	{
+		const char* name;
+		int64_t startNs;
+		int64_t endNs;
+	};
+
+	//one per thread that ever traced anything, never freed so a thread can exit before the trace gets written
+	struct ThreadTrace
+	{
+		uint32_t tid = 0;
+		const char* name = nullptr;
+		std::atomic<uint64_t> written{ 0 };
+		TraceRecord records[kTraceEventsPerThread];
+	};
+
+	std::mutex gThreadsLock; //only taken when a thread traces for the first time and by TraceWrite
+	std::vector<ThreadTrace*> gThreads;
+	int64_t gStartNs = 0;
+	thread_local ThreadTrace* tTrace = nullptr;
+	thread_local const char* tThreadName = nullptr;
+
+	ThreadTrace* ThisThread()
+	{
+		if (tTrace == nullptr)
+		{
+			ThreadTrace* trace = new ThreadTrace();
+			trace->name = tThreadName;
+			std::lock_guard<std::mutex> lock(gThreadsLock);
+			trace->tid = (uint32_t)gThreads.size() + 1;
+			gThreads.push_back(trace);
+			tTrace = trace;
+		}
+		return tTrace;
+	}
+}
+
+int64_t TraceNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceEvent(const char* name, int64_t startns, int64_t endns)
+{
+	ThreadTrace* trace = ThisThread();
+	//only this thread ever writes here, the release is for TraceWrite
+	uint64_t at = trace->written.load(std::memory_order_relaxed);
+	trace->records[at & (kTraceEventsPerThread - 1)] = { name, startns, endns };
+	trace->written.store(at + 1, std::memory_order_release);
+}
+
+void TraceThreadName(const char* name)
+{
+	if (tThreadName != nullptr)
+		return;
+	tThreadName = name;
+	if (tTrace != nullptr && tTrace->name == nullptr)
+		tTrace->name = name;
+}
+
+void TraceStart()
+{
+	if (gStartNs == 0)
+		gStartNs = TraceNow();
+	gTracing.store(true);
+}
+
+void TraceStop()
+{
+	gTracing.store(false);
+}
+
+bool TraceWrite(const char* path)
+{
+	FILE* out = nullptr;
+	if (fopen_s(&out, path, "wb") != 0 || out == nullptr)
+	{
+		fprintf(stderr, "couldn't open %s for the trace\n", path);
+		return false;
+	}
+	std::vector<ThreadTrace*> threads;
+	{
+		std::lock_guard<std::mutex> lock(gThreadsLock);
+		threads = gThreads;
+	}
+
+	//complete events (ph X), one per scope, so a ring that wrapped never leaves an end without its begin
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	const char* separator = "";
+	uint64_t events = 0;
+	uint64_t dropped = 0;
+	std::vector<TraceRecord> records;
+	for (ThreadTrace* thread : threads)
+	{
+		if (thread->name != nullptr)
+		{
+			fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", separator, thread->tid, thread->name);
+			separator = ",\n";
+		}
+		uint64_t end = thread->written.load(std::memory_order_acquire);
+		uint64_t begin = end > kTraceEventsPerThread ? end - kTraceEventsPerThread : 0;
+		records.clear();
+		for (uint64_t i = begin; i < end; ++i)
+			records.push_back(thread->records[i & (kTraceEventsPerThread - 1)]);
+		//anything the thread wrapped around onto while we were copying is garbage
+		uint64_t now = thread->written.load(std::memory_order_acquire);
+		uint64_t valid = now > kTraceEventsPerThread ? now - kTraceEventsPerThread : 0;
+		for (uint64_t i = begin; i < end; ++i)
+		{
+			if (i < valid)
+			{
+				++dropped;
+				continue;
+			}
+			const TraceRecord& record = records[i - begin];
+			fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", separator, record.name, thread->tid,
+				(record.startNs - gStartNs) / 1000.0, (record.endNs - record.startNs) / 1000.0);
+			separator = ",\n";
+			++events;
+		}
+		dropped += begin;
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	fprintf(stderr, "wrote %llu trace events from %zu threads to %s", (unsigned long long)events, threads.size(), path);
+	if (dropped > 0)
+		fprintf(stderr, ", the oldest %llu didn't fit in the buffers", (unsigned long long)dropped);
+	fprintf(stderr, "\n");
+	return true;
+}
+
+#else
+
+void TraceStart()
+{
+	fprintf(stderr, "tracing isn't compiled into this build, it needs a Debug build or WINORB_TRACE defined\n");
+}
+
+void TraceStop()
+{
+}
+
+bool TraceWrite(const char* path)
+{
+	(void)path;
+	return false;
+}
+
+#endif //WINORB_TRACE
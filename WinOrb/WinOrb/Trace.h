@@ -0,0 +1,55 @@
+#ifndef WINORB_TRACE_H
+#define WINORB_TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+
+//timeline tracing for chrome://tracing or ui.perfetto.dev. TRACE_SCOPE("name") records when the scope started and
+//how long it took on which thread, every FrameProfiler ScopedTimer does the same with its stage name. names have to
+//be string literals, only the pointer gets stored
+//
+//every thread writes into its own ring of the last kTraceEventsPerThread events without any locking, TraceWrite
+//merges them into one json file. builds without WINORB_TRACE defined compile all of it out, TraceStart and
+//TraceWrite then just say so
+const uint64_t kTraceEventsPerThread = 1 << 17; //power of two, about two minutes of frames
+
+void TraceStart();
+void TraceStop();
+//chrome trace event json, best called once the threads in it went quiet, events written while it runs may get dropped
+bool TraceWrite(const char* path);
+
+#ifdef WINORB_TRACE
+
+extern std::atomic<bool> gTracing;
+
+int64_t TraceNow(); //ns
+void TraceEvent(const char* name, int64_t startns, int64_t endns);
+void TraceThreadName(const char* name); //shows up as the thread's name in the viewer, only the first call counts
+
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name) : mName(gTracing.load(std::memory_order_relaxed) ? name : nullptr), mStart(mName != nullptr ? TraceNow() : 0) {};
+	~TraceScope()
+	{
+		if (mName != nullptr)
+			TraceEvent(mName, mStart, TraceNow());
+	};
+private:
+	const char* mName;
+	int64_t mStart;
+};
+
+#define WINORB_TRACE_JOIN2(a, b) a##b
+#define WINORB_TRACE_JOIN(a, b) WINORB_TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceScope WINORB_TRACE_JOIN(tracescope, __LINE__)(name)
+#define TRACE_THREAD(name) TraceThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD(name)
+
+#endif //WINORB_TRACE
+
+#endif //!WINORB_TRACE_H
@@ -46,6 +46,37 @@ struct Vertex3
 {
 	glm::vec3 pos;
 	glm::vec3 color;
+
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription description;
+		description.stride = sizeof(Vertex3);
+		description.binding = 0;
+		description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return description;
+	}
+
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescription()
+	{
+		std::vector<VkVertexInputAttributeDescription> description;
+
+		VkVertexInputAttributeDescription pos{};
+		pos.location = 0;
+		pos.binding = 0;
+		pos.format = VK_FORMAT_R32G32B32_SFLOAT;
+		pos.offset = offsetof(Vertex3, pos);
+
+		VkVertexInputAttributeDescription color{};
+		color.location = 1;
+		color.binding = 0;
+		color.format = VK_FORMAT_R32G32B32_SFLOAT;
+		color.offset = offsetof(Vertex3, color);
+
+		description.push_back(pos);
+		description.push_back(color);
+
+		return description;
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "VideoExporter.h"
+#include "WASAPILoopbackCapture.h"
+#include "Analyzer.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <io.h>
+#include <fcntl.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	//tiny mutex + condvar queue, Pop blocks until there's something or the queue gets closed and drained
+	template<typename T>
+	class BlockingQueue
+	{
+	public:
+		void Push(T val)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mQueue.push_back(val);
+			}
+			mCondition.notify_one();
+		}
+
+		bool Pop(T& val)
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return !mQueue.empty() || mClosed; });
+			if (mQueue.empty())
+				return false;
+			val = mQueue.front();
+			mQueue.pop_front();
+			return true;
+		}
+
+		void Close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mClosed = true;
+			}
+			mCondition.notify_all();
+		}
+	private:
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		std::deque<T> mQueue;
+		bool mClosed = false;
+	};
+
+	struct ExportPacket
+	{
+		uint64_t index = 0;
+		OffscreenFrame frame;
+		std::vector<uint8_t> encoded;
+	};
+
+	//frames' spectra get worked out this many at a time, spread over the pool
+	const uint64_t kAnalysisBatch = 64;
+
+	struct SubmittedFrame
+	{
+		uint32_t target;
+		uint64_t index;
+	};
+
+	//full range BT.601 (C420jpeg), chroma is the average of each 2x2 block
+	void RGBAToYUV420(const OffscreenFrame& frame, std::vector<uint8_t>& out)
+	{
+		const uint32_t w = frame.width;
+		const uint32_t h = frame.height;
+		const uint32_t cw = (w + 1) / 2;
+		const uint32_t ch = (h + 1) / 2;
+		out.resize((size_t)w * h + (size_t)cw * ch * 2);
+		uint8_t* yplane = out.data();
+		uint8_t* uplane = yplane + (size_t)w * h;
+		uint8_t* vplane = uplane + (size_t)cw * ch;
+		const uint8_t* rgba = frame.pixels.data();
+
+		for (uint32_t y = 0; y < h; ++y)
+		{
+			const uint8_t* row = rgba + (size_t)y * w * 4;
+			uint8_t* dst = yplane + (size_t)y * w;
+			for (uint32_t x = 0; x < w; ++x)
+			{
+				int r = row[x * 4 + 0];
+				int g = row[x * 4 + 1];
+				int b = row[x * 4 + 2];
+				dst[x] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+			}
+		}
+
+		for (uint32_t cy = 0; cy < ch; ++cy)
+		{
+			uint32_t y0 = cy * 2;
+			uint32_t y1 = glm::min(y0 + 1, h - 1);
+			for (uint32_t cx = 0; cx < cw; ++cx)
+			{
+				uint32_t x0 = cx * 2;
+				uint32_t x1 = glm::min(x0 + 1, w - 1);
+				const uint8_t* p00 = rgba + ((size_t)y0 * w + x0) * 4;
+				const uint8_t* p01 = rgba + ((size_t)y0 * w + x1) * 4;
+				const uint8_t* p10 = rgba + ((size_t)y1 * w + x0) * 4;
+				const uint8_t* p11 = rgba + ((size_t)y1 * w + x1) * 4;
+				int r = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+				int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+				int b = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+				uplane[(size_t)cy * cw + cx] = (uint8_t)glm::clamp(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128, 0, 255);
+				vplane[(size_t)cy * cw + cx] = (uint8_t)glm::clamp(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128, 0, 255);
+			}
+		}
+	}
+
+	//same analysis as the live loop, on the window of audio that ends right at the frame's timestamp
+	std::vector<float> AnalyzeAt(const WavData& audio, uint64_t endframe, FrameArena& arena)
+	{
+		const size_t windowsize = WASAPILoopbackCapture::kSampleSize;
+		const size_t channel = audio.channels - 1; //the live capture reads the last channel by default too
+		complex_sample sample(windowsize);
+		for (size_t i = 0; i < windowsize; ++i)
+		{
+			int64_t src = (int64_t)endframe - (int64_t)windowsize + (int64_t)i;
+			float val = 0.0f;
+			if (src >= 0 && (size_t)src < audio.FrameCount())
+				val = audio.samples[(size_t)src * audio.channels + channel];
+			sample[i] = fcomplex(val, 0.0f);
+		}
+		std::vector<float> magnitudes;
+		AnalyzeSpectrum(sample, AnalysisSettings(), magnitudes, arena);
+		arena.NextFrame();
+		return magnitudes;
+	}
+}
+
+bool VideoExporter::Export(const WavData& audio, const ExportSettings& settings)
+{
+	if (audio.channels == 0 || audio.sampleRate == 0 || settings.fps == 0)
+		return false;
+	if (settings.format == ExportFormat::Y4M && ((settings.width & 1) || (settings.height & 1)))
+	{
+		fprintf(stderr, "y4m export needs an even width and height for 4:2:0\n");
+		return false;
+	}
+
+	FILE* out = nullptr;
+	if (settings.outpath == "-")
+	{
+		_setmode(_fileno(stdout), _O_BINARY);
+		out = stdout;
+	}
+	else if (fopen_s(&out, settings.outpath.c_str(), "wb") != 0)
+	{
+		fprintf(stderr, "couldn't open %s for writing\n", settings.outpath.c_str());
+		return false;
+	}
+	static char outbuffer[1 << 20];
+	setvbuf(out, outbuffer, _IOFBF, sizeof(outbuffer));
+
+	VulkanDoodler doodler;
+	doodler.InitHeadless(settings.width, settings.height, settings.inflight);
+	const uint32_t targets = doodler.OffscreenTargetCount();
+
+	//frame i shows the audio up to i / fps, so the video lines up with the track when muxed back together
+	const double duration = (double)audio.FrameCount() / audio.sampleRate;
+	const uint64_t totalframes = (uint64_t)(duration * settings.fps + 0.5);
+
+	if (settings.format == ExportFormat::Y4M)
+	{
+		fprintf(out, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", settings.width, settings.height, settings.fps);
+	}
+	else
+	{
+		fprintf(stderr, "raw rgba, mux with: ffmpeg -f rawvideo -pix_fmt rgba -s %ux%u -r %u -i <video> -i <audio> ...\n",
+			settings.width, settings.height, settings.fps);
+	}
+
+	BlockingQueue<uint32_t> freetargets;
+	BlockingQueue<SubmittedFrame> submitted;
+	BlockingQueue<ExportPacket*> freepackets;
+	BlockingQueue<ExportPacket*> towrite;
+	std::atomic<bool> failed(false);
+
+	for (uint32_t i = 0; i < targets; ++i)
+		freetargets.Push(i);
+	//a couple more packets than targets so the writer can fall behind a bit without stalling readback
+	std::vector<ExportPacket> packets(targets + 2);
+	for (auto& packet : packets)
+		freepackets.Push(&packet);
+
+	//waits on each target's fence, copies it out of the mapped buffer, and hands the target straight back
+	std::thread readback([&]()
+	{
+		SubmittedFrame job;
+		while (submitted.Pop(job))
+		{
+			ExportPacket* packet = nullptr;
+			freepackets.Pop(packet);
+			doodler.ReadbackOffscreen(job.target, packet->frame);
+			packet->index = job.index;
+			freetargets.Push(job.target);
+			towrite.Push(packet);
+		}
+		towrite.Close();
+	});
+
+	std::thread writer([&]()
+	{
+		ExportPacket* packet = nullptr;
+		while (towrite.Pop(packet))
+		{
+			if (!failed)
+			{
+				bool ok = true;
+				if (settings.format == ExportFormat::Y4M)
+				{
+					RGBAToYUV420(packet->frame, packet->encoded);
+					uint64_t ptsmicros = packet->index * 1000000ull / settings.fps;
+					ok = fprintf(out, "FRAME Xpts=%llu\n", (unsigned long long)ptsmicros) > 0;
+					ok = ok && fwrite(packet->encoded.data(), 1, packet->encoded.size(), out) == packet->encoded.size();
+				}
+				else
+				{
+					ok = fwrite(packet->frame.pixels.data(), 1, packet->frame.pixels.size(), out) == packet->frame.pixels.size();
+				}
+				if (!ok)
+				{
+					fprintf(stderr, "writing frame %llu failed, stopping the export\n", (unsigned long long)packet->index);
+					failed = true;
+				}
+			}
+			freepackets.Push(packet);
+		}
+	});
+
+	//every frame's window is independent, so a batch of them goes through the fft on all cores at once
+	//the render loop stays on this thread
+	ThreadPool pool;
+	std::vector<std::vector<float>> batch(kAnalysisBatch);
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t frame = 0;
+	for (; frame < totalframes && !failed; ++frame)
+	{
+		if (frame % kAnalysisBatch == 0)
+		{
+			//one sample per batch in the profiler
+			ScopedTimer timer(doodler.GetProfiler(), ProfileStage::Analysis);
+			uint64_t first = frame;
+			size_t count = (size_t)glm::min(kAnalysisBatch, totalframes - first);
+			pool.ParallelFor(0, count, 1, [&](size_t begin, size_t end)
+			{
+				FrameArena arena;
+				for (size_t i = begin; i < end; ++i)
+					batch[i] = AnalyzeAt(audio, (first + i) * audio.sampleRate / settings.fps, arena);
+			});
+		}
+
+		uint32_t target = 0;
+		freetargets.Pop(target);
+		doodler.UpdateChart(batch[frame % kAnalysisBatch]);
+		doodler.SetOrbTime(frame / (float)settings.fps);
+		doodler.SubmitOffscreen(target);
+		submitted.Push({ target, frame });
+	}
+	submitted.Close();
+	readback.join();
+	writer.join();
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "exported %llu frames (%.1fs of audio) in %.2fs, %.1fx realtime\n",
+		(unsigned long long)frame, frame / (double)settings.fps, elapsed, elapsed > 0 ? frame / (double)settings.fps / elapsed : 0.0);
+
+	doodler.GetProfiler().Log(stderr);
+
+	fflush(out);
+	if (out != stdout)
+		fclose(out);
+	doodler.Destroy();
+	return !failed;
+}
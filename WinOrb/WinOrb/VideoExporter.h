@@ -0,0 +1,32 @@
+#ifndef WINORB_VIDEO_EXPORTER_H
+#define WINORB_VIDEO_EXPORTER_H
+
+#include "VulkanDoodler.h"
+#include "File.h"
+#include <string>
+
+enum class ExportFormat
+{
+	RawRGBA, //just the readback, back to back
+	Y4M, //4:2:0 yuv4mpeg, ffmpeg/x264 eat it straight from a pipe
+};
+
+struct ExportSettings
+{
+	std::string outpath = "-"; //"-" for stdout
+	ExportFormat format = ExportFormat::Y4M;
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	uint32_t fps = 60;
+	uint32_t inflight = 4; //readback buffers in flight, each one has its own fence
+};
+
+//renders the visualization for a recorded track as fast as the gpu (or lavapipe) goes
+//rendering, readback and file writing each get their own thread so they overlap, the analysis goes wide on a thread pool
+class VideoExporter
+{
+public:
+	bool Export(const WavData& audio, const ExportSettings& settings);
+};
+
+#endif //!WINORB_VIDEO_EXPORTER_H
@@ -1,10 +1,20 @@
 #include "VulkanDoodler.h"
-#include "File.h"
+#include "Shaders.h"
 #include "GLFW/glfw3.h"
 #include "glm/common.hpp"
+#include "glm/gtc/packing.hpp"
+#include "glm/gtc/matrix_transform.hpp"
 #include "Vertex.h"
+#include "Analyzer.h"
+#include "ChartLevels.h"
+#include "Icosphere.h"
+#include "imgui.h"
+#include "backends/imgui_impl_glfw.h"
+#include "backends/imgui_impl_vulkan.h"
 #include <vector>
 #include <cassert>
+#include <math.h>
+#include <algorithm>
 
 #pragma optimize("", off)
 #define swaggy_assert(expr) if(!(expr)) throw;
@@ -17,73 +27,152 @@ const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
 
-const std::vector<Vertex2> GenerateChartFromSample(std::vector<float> sample)
+//two triangles between each pair of neighbouring bins, bin i is vertices 2i (bottom) and 2i + 1 (top)
+const std::vector<uint32_t> generateindices(size_t size)
 {
-	std::vector<Vertex2> chart;
-
-	const float dbform = 10 / log(10);
-	const float intensitycoeff = 1.0f * 10e-12;
-	
-	static float smax = 32;
-	float maxval = 0;
-	for (int i = 0; i < sample.size(); ++i)
-		if (sample[i] > maxval)
-			maxval = sample[i];
-	if (maxval < 1)
-		maxval = 1;
-
-	smax = (smax + maxval) / 2;
-
-	for (int i = 0; i < sample.size(); ++i)
+	std::vector<uint32_t> indices;
+	indices.reserve(size > 1 ? (size - 1) * 6 : 0);
+	for (uint32_t i = 1; i < size; ++i)
 	{
-		float x = 0;
-		if(i != 0) x = log(i) / log(10);
-		float y = dbform * log(sample[i] / intensitycoeff);
-		y /= 150;
-		x /= 3.01f;
-		//y /= smax;
-		y /= -1.0f;
-		//x -= 0.5f;
-
-		Vertex2 v1 = { {x - 0.5, y + 0.5f}, {1.0f, 0.0f, 0.0f} };
-		Vertex2 v2 = { {x - 0.5, .5f}, {0.0f, 1.0f, 1.0f} };
-
-		chart.push_back(v2);//bottom
-		chart.push_back(v1);//top
+		uint32_t twice = i * 2;
+		indices.push_back(twice - 2);//bottom left
+		indices.push_back(twice - 1);//top left
+		indices.push_back(twice + 1);//top right
+
+		indices.push_back(twice + 1);//top right
+		indices.push_back(twice);//bottom right
+		indices.push_back(twice - 2);//bottom left
 	}
-	return chart;
+	return indices;
 }
 
-const std::vector<uint16_t> generateindices(size_t size)
+const int MAX_FRAMES_IN_FLIGHT = 2;
+//dragging a window edge fires a resize every few pixels, wait for it to sit still this long before rebuilding
+const std::chrono::milliseconds kResizeSettleTime(50);
+
+//waterfall history, 8192 rows is a bit over 2 minutes at 60fps and 16MB of R16 at full bin resolution
+const uint32_t kWaterfallBins = 1024;
+const uint32_t kWaterfallMaxRows = 8192;
+const uint32_t kWaterfallVisibleRows = 600;
+const glm::vec4 kWaterfallRect = { -0.5f, 0.5f, 0.5f, 1.0f }; //right under the bars, newest row on top
+const uint32_t kColormapSize = 256;
+
+//std140, matches WaterfallParams in waterfall.vert/frag
+struct WaterfallParams
 {
-	std::vector<uint16_t> indices;
-	for (int i = 0; i < size; ++i)
-	{	
-		int twice = i * 2;
-		if (i != 0)
-		{
-			//finish the previous quad
-			indices.push_back(twice + 1);//top right
-
-			indices.push_back(twice + 1);//top right
-			indices.push_back(twice);//bottom right
-			indices.push_back(twice - 2);//bottom left
+	uint32_t head;
+	uint32_t rows;
+	uint32_t visibleRows;
+	uint32_t bins;
+	glm::vec4 rect;
+};
 
-			//start the next quad
-			indices.push_back(twice); //down left
-			indices.push_back(twice + 1);//top left
-		}
-		else //even
-		{
-			indices.push_back(twice); //down left
-			indices.push_back(twice + 1);//top left
-		}
+//inferno-ish, black -> purple -> red -> orange -> pale yellow
+void GenerateColormap(std::vector<uint8_t>& rgba)
+{
+	const glm::vec3 keys[] =
+	{
+		{ 0.0f, 0.0f, 0.02f },
+		{ 0.34f, 0.06f, 0.43f },
+		{ 0.73f, 0.21f, 0.33f },
+		{ 0.98f, 0.55f, 0.04f },
+		{ 0.99f, 1.0f, 0.64f },
+	};
+	const size_t keycount = sizeof(keys) / sizeof(keys[0]);
+	rgba.resize(kColormapSize * 4);
+	for (uint32_t i = 0; i < kColormapSize; ++i)
+	{
+		float t = (float)i / (kColormapSize - 1) * (keycount - 1);
+		size_t key = glm::min((size_t)t, keycount - 2);
+		glm::vec3 color = glm::mix(keys[key], keys[key + 1], t - (float)key);
+		rgba[i * 4 + 0] = (uint8_t)(color.r * 255.0f + 0.5f);
+		rgba[i * 4 + 1] = (uint8_t)(color.g * 255.0f + 0.5f);
+		rgba[i * 4 + 2] = (uint8_t)(color.b * 255.0f + 0.5f);
+		rgba[i * 4 + 3] = 255;
 	}
+}
 
-	return indices;
+void ImageBarrier(VkCommandBuffer commandbuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(commandbuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+void BufferBarrier(VkCommandBuffer commandbuffer, VkBuffer buffer,
+	VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandbuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+//the top of ChartInput in chart.comp, the raw magnitudes follow right after
+struct ChartInputHeader
+{
+	ChartStyle style;
+	uint32_t bins;
+};
+static_assert(sizeof(ChartInputHeader) == 32, "ChartInputHeader has to match chart.comp");
+const uint32_t kChartStateHeaderSize = 16; //running max + padding, then one vec4 per bin
+const uint32_t kChartBinStateSize = 16;
+const uint32_t kChartVerticesPerBin = 4; //bar top/bottom + peak tick top/bottom
+const float kChartWidth = 0.5f; //of the framebuffer, the bars span -0.5..0.5 in clip space
+
+//the top of FFTInput in fft.comp, the raw samples follow right after
+struct FFTInputHeader
+{
+	uint32_t size;
+	uint32_t log2size;
+	uint32_t window;
+	uint32_t rowBins; //waterfall texels, independent of the chart's bar count
+};
+
+//OrbCamera in orb.vert/orb.frag, std140
+struct OrbCamera
+{
+	glm::mat4 viewProj;
+	glm::mat4 model;
+	glm::vec4 lightDir;
+	float amplitude;
+	uint32_t bins;
+	float time;
+	float pulse; //beat pulse, 0 to 1
+};
+static_assert(sizeof(OrbCamera) == 160, "OrbCamera has to match orb.vert");
+const uint32_t kOrbSubdivisions = 5; //20480 triangles
+const float kOrbAmplitude = 0.6f;
+const float kOrbSpin = 0.3f; //radians per second
+const float kBeatPulseDecay = 0.12f; //seconds for a beat pulse to fall to 1/e
+
+//timestamp slots written by each image's command buffer
+enum TimestampQuery
+{
+	kQueryFrameBegin,
+	kQueryRenderPassEnd,
+	kQueryTransferEnd,
+	kQueriesPerImage
+};
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -91,13 +180,16 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
-std::vector<const char*> GetRequiredInstanceExtensions()
+std::vector<const char*> VulkanDoodler::GetRequiredInstanceExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	std::vector<const char*> extensions;
+	if (!mHeadless) //glfw isn't even initialized when headless
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers)
 	{
@@ -107,23 +199,71 @@ std::vector<const char*> GetRequiredInstanceExtensions()
 	return extensions;
 }
 
+std::vector<const char*> VulkanDoodler::GetRequiredDeviceExtensions()
+{
+	if (mHeadless)
+	{
+		return {};
+	}
+	return deviceExtensions;
+}
+
 void VulkanDoodler::Init()
 {
 	Super::Init();
+	InitVulkan();
+	CreateOverlay();
+}
+
+void VulkanDoodler::InitHeadless(uint32_t width, uint32_t height, uint32_t targetcount)
+{
+	mHeadless = true;
+	mSwapExtent = { width, height };
+	mOffscreenTargetCount = glm::max(targetcount, 1u);
+	InitVulkan();
+}
+
+void VulkanDoodler::InitVulkan()
+{
 	CreateInstance();
 	SetupMessengerCallback();
-	CreateSurface();
+	if (!mHeadless)
+	{
+		CreateSurface();
+	}
 	GetBestGraphicsDevice();
 	CreateLogicalDevice();
-	CreateSwapChain();
+	if (mHeadless)
+	{
+		CreateOffscreenTargets();
+	}
+	else
+	{
+		CreateSwapChain();
+	}
 	CreateImageViews();
+	mMsaaSamples = ChooseSampleCount();
+	mDepthFormat = ChooseDepthFormat();
+	CreateRenderTargets();
 	CreateRenderPass();
 	CreateGraphicsPipeline();
 	CreateFrameBuffers();
 	CreateCommandPool();
 	CreateCommandBuffer();
-	CreateVertexBuffer();
+	CreateChartState();
+	CreateChartCompute();
+	UpdateChartLayout();
+	CreateChartBuffers();
 	CreateIndexBuffer();
+	CreateOrb();
+	CreateOrbBuffers();
+	CreateWaterfall();
+	CreateFFTCompute();
+	if (mHeadless)
+	{
+		CreateReadbackBuffers();
+	}
+	CreateImageCommandBuffers();
 	CreateSyncObjects();
 }
 
@@ -171,7 +311,7 @@ void VulkanDoodler::CreateSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = mode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = mSwapChain; //VK_NULL_HANDLE the first time, lets the driver recycle stuff on a rebuild
 
 	VkResult res = vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain);
 	swaggy_assert(res == VK_SUCCESS);
@@ -182,38 +322,79 @@ void VulkanDoodler::CreateSwapChain()
 	mSwapExtent = extent;
 }
 
-void VulkanDoodler::CreateImageViews()
+void VulkanDoodler::CreateOffscreenTargets()
 {
-	mImageViews.resize(mSwapImages.size());
+	//plain RGBA so the readback is directly usable, no swizzling BGRA or undoing sRGB
+	mSwapFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	mSwapImages.resize(mOffscreenTargetCount);
+	mOffscreenImageMemory.resize(mOffscreenTargetCount);
 
-	VkImageViewCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	createInfo.format = mSwapFormat;
-	createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-	createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-	createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-	createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
-	createInfo.subresourceRange.baseArrayLayer = 0;
-	createInfo.subresourceRange.layerCount = 1;
+	for (uint32_t i = 0; i < mOffscreenTargetCount; ++i)
+	{
+		CreateImage(mSwapExtent.width, mSwapExtent.height, mSwapFormat,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			mSwapImages[i], mOffscreenImageMemory[i]);
+	}
+}
+
+void VulkanDoodler::CreateReadbackBuffers()
+{
+	VkDeviceSize buffersize = (VkDeviceSize)mSwapExtent.width * mSwapExtent.height * 4;
+
+	//prefer cached memory if there is any, reading back out of write-combined memory is painfully slow
+	VkMemoryPropertyFlags readbackFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memProperties);
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+	{
+		VkMemoryPropertyFlags cached = readbackFlags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		if ((memProperties.memoryTypes[i].propertyFlags & cached) == cached)
+		{
+			readbackFlags = cached;
+			break;
+		}
+	}
 
+	size_t count = mSwapImages.size();
+	mReadbackBuffers.resize(count);
+	mReadbackMemory.resize(count);
+	mReadbackMapped.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		CreateBuffer(buffersize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackFlags, mReadbackBuffers[i], mReadbackMemory[i]);
+		swaggy_assert(vkMapMemory(mDevice, mReadbackMemory[i], 0, buffersize, 0, &mReadbackMapped[i]) == VK_SUCCESS);
+	}
+}
+
+void VulkanDoodler::CreateImageViews()
+{
+	mImageViews.resize(mSwapImages.size());
 	for (size_t i = 0; i < mImageViews.size(); ++i)
 	{
-		createInfo.image = mSwapImages[i];
-		swaggy_assert(vkCreateImageView(mDevice, &createInfo, nullptr, &mImageViews[i]) == VK_SUCCESS);
+		mImageViews[i] = CreateImageView(mSwapImages[i], mSwapFormat);
 	}
 }
 
-void VulkanDoodler::CreateGraphicsPipeline()
+void VulkanDoodler::CreateRenderTargets()
 {
-	auto vertCode = readfile("shaders/vert.spv");
-	auto fragCode = readfile("shaders/frag.spv");
+	//one set for every image, the render pass's external dependency keeps consecutive frames from overlapping on them
+	if (mMsaaSamples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		CreateImage(mSwapExtent.width, mSwapExtent.height, mSwapFormat,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+			mColorImage, mColorImageMemory, mMsaaSamples);
+		mColorImageView = CreateImageView(mColorImage, mSwapFormat);
+	}
+	CreateImage(mSwapExtent.width, mSwapExtent.height, mDepthFormat,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+		mDepthImage, mDepthImageMemory, mMsaaSamples);
+	mDepthImageView = CreateImageView(mDepthImage, mDepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+}
 
-	VkShaderModule vertModule = CreateShaderModule(vertCode);
-	VkShaderModule fragModule = CreateShaderModule(fragCode);
+void VulkanDoodler::CreateGraphicsPipeline()
+{
+	VkShaderModule vertModule = CreateShaderModule(GetShaderCode(ShaderId::ShaderVert));
+	VkShaderModule fragModule = CreateShaderModule(GetShaderCode(ShaderId::ShaderFrag));
 
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -287,7 +468,7 @@ void VulkanDoodler::CreateGraphicsPipeline()
 	VkPipelineMultisampleStateCreateInfo msInfo{};
 	msInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	msInfo.sampleShadingEnable = VK_FALSE;
-	msInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	msInfo.rasterizationSamples = mMsaaSamples;
 	msInfo.minSampleShading = 1.0f;
 	msInfo.pSampleMask = nullptr;
 	msInfo.alphaToCoverageEnable = VK_FALSE;
@@ -330,8 +511,14 @@ void VulkanDoodler::CreateGraphicsPipeline()
 	pipelineInfo.pInputAssemblyState = &assemblyInfo;
 	pipelineInfo.pViewportState = &viewportInfo;
 	pipelineInfo.pRasterizationState = &rasterInfo;
+	//flat 2d, drawn in order without touching the depth buffer
+	VkPipelineDepthStencilStateCreateInfo depthInfo{};
+	depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthInfo.depthTestEnable = VK_FALSE;
+	depthInfo.depthWriteEnable = VK_FALSE;
+
 	pipelineInfo.pMultisampleState = &msInfo;
-	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pDepthStencilState = &depthInfo;
 	pipelineInfo.pColorBlendState = &colorBlend;
 	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = mPipelineLayout;
@@ -348,41 +535,81 @@ void VulkanDoodler::CreateGraphicsPipeline()
 
 void VulkanDoodler::CreateRenderPass()
 {
-	VkAttachmentDescription colorAttachment{};
-	colorAttachment.format = mSwapFormat;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	bool msaa = mMsaaSamples != VK_SAMPLE_COUNT_1_BIT;
+	//headless targets get copied out to a buffer right after the pass instead of presented
+	VkImageLayout outputLayout = mHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	//0: color, 1: depth, 2: the swapchain image the msaa color resolves into
+	VkAttachmentDescription attachments[3]{};
+	attachments[0].format = mSwapFormat;
+	attachments[0].samples = mMsaaSamples;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = msaa ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : outputLayout;
+
+	attachments[1].format = mDepthFormat;
+	attachments[1].samples = mMsaaSamples;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	attachments[2].format = mSwapFormat;
+	attachments[2].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[2].finalLayout = outputLayout;
 
 	VkAttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.attachment = 0;
 	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 1;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	VkAttachmentReference resolveAttachmentRef{};
+	resolveAttachmentRef.attachment = 2;
+	resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkSubpassDescription subpass{};
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+	subpass.pResolveAttachments = msaa ? &resolveAttachmentRef : nullptr;
 	
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	//the color and depth targets are shared between frames, so this also waits for the previous frame's writes to them
+	VkSubpassDependency dependencies[2]{};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	//headless: the copy to the readback buffer has to wait for the color writes
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 	VkRenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colorAttachment;
+	renderPassInfo.attachmentCount = msaa ? 3 : 2;
+	renderPassInfo.pAttachments = attachments;
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+	renderPassInfo.dependencyCount = mHeadless ? 2 : 1;
+	renderPassInfo.pDependencies = dependencies;
 
 	swaggy_assert(vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mRenderPass) == VK_SUCCESS);
 }
@@ -392,11 +619,18 @@ void VulkanDoodler::CreateFrameBuffers()
 	mFrameBuffers.resize(mImageViews.size());
 	for (int i = 0; i < mImageViews.size(); ++i)
 	{
+		//same order as the render pass attachments
+		std::vector<VkImageView> attachments;
+		if (mMsaaSamples != VK_SAMPLE_COUNT_1_BIT)
+			attachments = { mColorImageView, mDepthImageView, mImageViews[i] };
+		else
+			attachments = { mImageViews[i], mDepthImageView };
+
 		VkFramebufferCreateInfo framebufferInfo{};
 		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebufferInfo.renderPass = mRenderPass;
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.pAttachments = &mImageViews[i];
+		framebufferInfo.attachmentCount = (uint32_t)attachments.size();
+		framebufferInfo.pAttachments = attachments.data();
 		framebufferInfo.width = mSwapExtent.width;
 		framebufferInfo.height = mSwapExtent.height;
 		framebufferInfo.layers = 1;
@@ -417,73 +651,710 @@ void VulkanDoodler::CreateCommandPool()
 	swaggy_assert(vkCreateCommandPool(mDevice, &cmdpoolInfo, nullptr, &mCommandPool) == VK_SUCCESS);
 }
 
-void VulkanDoodler::CreateVertexBuffer()
+void VulkanDoodler::CreateChartState()
 {
-	std::vector<float> emptysample(1024, 1.0f);
-	auto chart = GenerateChartFromSample(emptysample);
-	uint32_t buffersize = sizeof(chart[0]) * chart.size();
+	mChartMagnitudes.assign(mChartBins, 0.0f);
 
+	//zeroed once, the compute pass carries it from frame to frame from then on
+	VkDeviceSize statesize = kChartStateHeaderSize + (VkDeviceSize)kChartBinStateSize * mChartBins;
+	CreateBuffer(statesize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		mChartState,
+		mChartStateMemory
+	);
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+	vkCmdFillBuffer(commandBuffer, mChartState, 0, VK_WHOLE_SIZE, 0);
+	BufferBarrier(commandBuffer, mChartState, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	EndSingleTimeCommands(commandBuffer);
+}
 
-	//staging buffer
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(buffersize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, 
-		stagingBufferMemory
+void VulkanDoodler::CreateChartCompute()
+{
+	VkDescriptorSetLayoutBinding bindings[4]{};
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		bindings[i].binding = i; //input, state, vertices, bar layout
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+	swaggy_assert(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mChartSetLayout) == VK_SUCCESS);
+
+	//one set per swapchain image, with room for a retired swapchain's worth still waiting to be freed
+	const uint32_t maxsets = 64;
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = maxsets * 4;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets = maxsets;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	swaggy_assert(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mChartDescriptorPool) == VK_SUCCESS);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mChartSetLayout;
+	swaggy_assert(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mChartPipelineLayout) == VK_SUCCESS);
+
+	VkShaderModule compModule = CreateShaderModule(GetShaderCode(ShaderId::ChartComp));
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = mChartPipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	swaggy_assert(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mChartPipeline) == VK_SUCCESS);
+	vkDestroyShaderModule(mDevice, compModule, nullptr);
+}
+
+void VulkanDoodler::CreateChartBuffers()
+{
+	//host visible and mapped for the lifetime of the buffer, the magnitudes get memcpy'd straight in
+	//right before the image is submitted, no staging buffer or queue wait per frame
+	//the layout can have as many bars as there are bins, on a narrow enough window
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	VkDeviceSize alignment = glm::max(properties.limits.minStorageBufferOffsetAlignment, (VkDeviceSize)16);
+	VkDeviceSize magnitudesize = sizeof(ChartInputHeader) + sizeof(float) * mChartBins;
+	mChartLayoutOffset = (magnitudesize + alignment - 1) / alignment * alignment;
+	VkDeviceSize inputsize = mChartLayoutOffset + sizeof(ChartLayoutHeader) + sizeof(ChartBar) * mChartBins;
+	VkDeviceSize vertexsize = sizeof(Vertex2) * kChartVerticesPerBin * mChartBins;
+	size_t count = mSwapImages.size();
+	mChartInputBuffers.resize(count);
+	mChartInputMemory.resize(count);
+	mChartInputMapped.resize(count);
+	mChartLayoutWritten.assign(count, 0);
+	mVertexBuffers.resize(count);
+	mVertexBufferMemory.resize(count);
+	mChartDescriptorSets.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		CreateBuffer(inputsize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			mChartInputBuffers[i],
+			mChartInputMemory[i]
+		);
+		swaggy_assert(vkMapMemory(mDevice, mChartInputMemory[i], 0, inputsize, 0, &mChartInputMapped[i]) == VK_SUCCESS);
+		WriteChartInput((uint32_t)i);
+
+		//only the compute pass writes these, so they can sit in device local memory
+		CreateBuffer(vertexsize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			mVertexBuffers[i],
+			mVertexBufferMemory[i]
 		);
+	}
 
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, buffersize, 0, &data);
-	memcpy(data, chart.data(), (size_t)buffersize);
-	vkUnmapMemory(mDevice, stagingBufferMemory);
+	std::vector<VkDescriptorSetLayout> layouts(count, mChartSetLayout);
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = mChartDescriptorPool;
+	setInfo.descriptorSetCount = (uint32_t)count;
+	setInfo.pSetLayouts = layouts.data();
+	swaggy_assert(vkAllocateDescriptorSets(mDevice, &setInfo, mChartDescriptorSets.data()) == VK_SUCCESS);
 
+	for (size_t i = 0; i < count; ++i)
+	{
+		VkDescriptorBufferInfo bufferInfos[4] =
+		{
+			{ mChartInputBuffers[i], 0, mChartLayoutOffset },
+			{ mChartState, 0, VK_WHOLE_SIZE },
+			{ mVertexBuffers[i], 0, VK_WHOLE_SIZE },
+			{ mChartInputBuffers[i], mChartLayoutOffset, VK_WHOLE_SIZE },
+		};
+		VkWriteDescriptorSet writes[4]{};
+		for (uint32_t binding = 0; binding < 4; ++binding)
+		{
+			writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[binding].dstSet = mChartDescriptorSets[i];
+			writes[binding].dstBinding = binding;
+			writes[binding].descriptorCount = 1;
+			writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[binding].pBufferInfo = &bufferInfos[binding];
+		}
+		vkUpdateDescriptorSets(mDevice, 4, writes, 0, nullptr);
+	}
+}
 
-	//vertex buffer
-	CreateBuffer(buffersize, 
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		mVertexBuffer, 
-		mVertexBufferMemory
-	);
+void VulkanDoodler::CreateIndexBuffer()
+{
+	//the indices only go up to 2 * bins, the peak ticks reuse them through the vertex offset
+	auto indices = generateindices(mChartBins);
+	mIndexCount = (uint32_t)indices.size();
+	if (2 * (size_t)mChartBins <= 0x10000)
+	{
+		mIndexType = VK_INDEX_TYPE_UINT16;
+		std::vector<uint16_t> narrow(indices.begin(), indices.end());
+		CreateStaticBuffer(narrow.data(), sizeof(narrow[0]) * narrow.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			mIndexBuffer, mIndexBufferMemory);
+	}
+	else
+	{
+		mIndexType = VK_INDEX_TYPE_UINT32;
+		CreateStaticBuffer(indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			mIndexBuffer, mIndexBufferMemory);
+	}
+}
 
-	CopyBuffer(mVertexBuffer, stagingBuffer, buffersize);
+void VulkanDoodler::CreateOrb()
+{
+	std::vector<Vertex3> vertices;
+	std::vector<uint32_t> indices;
+	GenerateIcosphere(kOrbSubdivisions, vertices, indices);
+	mOrbIndexCount = (uint32_t)indices.size();
+	CreateStaticBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		mOrbVertexBuffer, mOrbVertexBufferMemory);
+	CreateStaticBuffer(indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		mOrbIndexBuffer, mOrbIndexBufferMemory);
+
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	bindings[0].binding = 0; //camera
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = 1; //chart state, the smoothed levels chart.comp leaves behind
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	swaggy_assert(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mOrbSetLayout) == VK_SUCCESS);
+
+	//same deal as the chart pool, room for the current sets plus a retired swapchain's worth
+	const uint32_t maxsets = 64;
+	VkDescriptorPoolSize poolSizes[2]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = maxsets;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = maxsets;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets = maxsets;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	swaggy_assert(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mOrbDescriptorPool) == VK_SUCCESS);
+
+	CreateOrbPipeline();
+}
 
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+void VulkanDoodler::CreateOrbPipeline()
+{
+	VkShaderModule vertModule = CreateShaderModule(GetShaderCode(ShaderId::OrbVert));
+	VkShaderModule fragModule = CreateShaderModule(GetShaderCode(ShaderId::OrbFrag));
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragModule;
+	shaderStages[1].pName = "main";
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	auto bindingDescription = Vertex3::getBindingDescription();
+	auto attributeDescriptions = Vertex3::getAttributeDescription();
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+	assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.scissorCount = 1;
+
+	//the projection flips y, which keeps the icosphere's outside-ccw winding ccw on screen
+	VkPipelineRasterizationStateCreateInfo rasterInfo{};
+	rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterInfo.lineWidth = 1.0f;
+	rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo msInfo{};
+	msInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	msInfo.rasterizationSamples = mMsaaSamples;
+	msInfo.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthInfo{};
+	depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthInfo.depthTestEnable = VK_TRUE;
+	depthInfo.depthWriteEnable = VK_TRUE;
+	depthInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlend{};
+	colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlend.attachmentCount = 1;
+	colorBlend.pAttachments = &colorBlendAttachment;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mOrbSetLayout;
+	swaggy_assert(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mOrbPipelineLayout) == VK_SUCCESS);
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &assemblyInfo;
+	pipelineInfo.pViewportState = &viewportInfo;
+	pipelineInfo.pRasterizationState = &rasterInfo;
+	pipelineInfo.pMultisampleState = &msInfo;
+	pipelineInfo.pDepthStencilState = &depthInfo;
+	pipelineInfo.pColorBlendState = &colorBlend;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = mOrbPipelineLayout;
+	pipelineInfo.renderPass = mRenderPass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineIndex = -1;
+	swaggy_assert(vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mOrbPipeline) == VK_SUCCESS);
+
+	vkDestroyShaderModule(mDevice, vertModule, nullptr);
+	vkDestroyShaderModule(mDevice, fragModule, nullptr);
 }
 
-void VulkanDoodler::CreateIndexBuffer()
+void VulkanDoodler::CreateOrbBuffers()
 {
-	auto indices = generateindices(1024);
-	VkDeviceSize buffersize = sizeof(indices[0]) * indices.size();
+	//one camera per image, written right before that image gets submitted like the chart input
+	size_t count = mSwapImages.size();
+	mOrbCameraBuffers.resize(count);
+	mOrbCameraMemory.resize(count);
+	mOrbCameraMapped.resize(count);
+	mOrbDescriptorSets.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		CreateBuffer(sizeof(OrbCamera),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			mOrbCameraBuffers[i],
+			mOrbCameraMemory[i]
+		);
+		swaggy_assert(vkMapMemory(mDevice, mOrbCameraMemory[i], 0, sizeof(OrbCamera), 0, &mOrbCameraMapped[i]) == VK_SUCCESS);
+		WriteOrbCamera((uint32_t)i);
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(count, mOrbSetLayout);
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = mOrbDescriptorPool;
+	setInfo.descriptorSetCount = (uint32_t)count;
+	setInfo.pSetLayouts = layouts.data();
+	swaggy_assert(vkAllocateDescriptorSets(mDevice, &setInfo, mOrbDescriptorSets.data()) == VK_SUCCESS);
 
+	for (size_t i = 0; i < count; ++i)
+	{
+		VkDescriptorBufferInfo cameraInfo{ mOrbCameraBuffers[i], 0, sizeof(OrbCamera) };
+		VkDescriptorBufferInfo stateInfo{ mChartState, 0, VK_WHOLE_SIZE };
+		VkWriteDescriptorSet writes[2]{};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = mOrbDescriptorSets[i];
+		writes[0].dstBinding = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		writes[0].pBufferInfo = &cameraInfo;
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = mOrbDescriptorSets[i];
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[1].pBufferInfo = &stateInfo;
+		vkUpdateDescriptorSets(mDevice, 2, writes, 0, nullptr);
+	}
+}
+
+void VulkanDoodler::CreateWaterfall()
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	mWaterfallRows = glm::min(kWaterfallMaxRows, properties.limits.maxImageDimension2D);
+	mWaterfallHead = 0;
+	mWaterfallRow.assign(kWaterfallBins, 0);
+	mWaterfallLevels.assign(kWaterfallBins, 0.0f);
+
+	CreateImage(kWaterfallBins, mWaterfallRows, VK_FORMAT_R16_SFLOAT,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, mWaterfallImage, mWaterfallImageMemory);
+	mWaterfallImageView = CreateImageView(mWaterfallImage, VK_FORMAT_R16_SFLOAT);
+	CreateImage(kColormapSize, 1, VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, mColormapImage, mColormapImageMemory);
+	mColormapImageView = CreateImageView(mColormapImage, VK_FORMAT_R8G8B8A8_UNORM);
+	CreateBuffer(sizeof(WaterfallParams),
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		mWaterfallParams,
+		mWaterfallParamsMemory
+	);
+
+	//one-off: clear the history, upload the colormap and the params
+	std::vector<uint8_t> colormap;
+	GenerateColormap(colormap);
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(buffersize,
+	CreateBuffer(colormap.size(),
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		stagingBuffer,
 		stagingBufferMemory
 	);
-
 	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, buffersize, 0, &data);
-	memcpy(data, indices.data(), (size_t)buffersize);
+	vkMapMemory(mDevice, stagingBufferMemory, 0, colormap.size(), 0, &data);
+	memcpy(data, colormap.data(), colormap.size());
 	vkUnmapMemory(mDevice, stagingBufferMemory);
 
-	CreateBuffer(buffersize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		mIndexBuffer, 
-		mIndexBufferMemory
-	);
-
-	CopyBuffer(mIndexBuffer, stagingBuffer, buffersize);
+	WaterfallParams params{};
+	params.head = mWaterfallHead;
+	params.rows = mWaterfallRows;
+	params.visibleRows = glm::min(kWaterfallVisibleRows, mWaterfallRows);
+	params.bins = kWaterfallBins;
+	params.rect = kWaterfallRect;
+
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+	ImageBarrier(commandBuffer, mWaterfallImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	ImageBarrier(commandBuffer, mColormapImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkClearColorValue black{};
+	VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdClearColorImage(commandBuffer, mWaterfallImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &range);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { kColormapSize, 1, 1 };
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, mColormapImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkCmdUpdateBuffer(commandBuffer, mWaterfallParams, 0, sizeof(params), &params);
+
+	ImageBarrier(commandBuffer, mWaterfallImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	ImageBarrier(commandBuffer, mColormapImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	BufferBarrier(commandBuffer, mWaterfallParams, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	EndSingleTimeCommands(commandBuffer);
 
 	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
 	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+
+	//per frame only one row of 2KB goes up, through these
+	uint32_t slots = mHeadless ? mOffscreenTargetCount : MAX_FRAMES_IN_FLIGHT;
+	VkDeviceSize rowsize = kWaterfallBins * sizeof(uint16_t);
+	mWaterfallStaging.resize(slots);
+	mWaterfallStagingMemory.resize(slots);
+	mWaterfallStagingMapped.resize(slots);
+	for (uint32_t i = 0; i < slots; ++i)
+	{
+		//storage too, the gpu fft writes the row straight in
+		CreateBuffer(rowsize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			mWaterfallStaging[i],
+			mWaterfallStagingMemory[i]
+		);
+		swaggy_assert(vkMapMemory(mDevice, mWaterfallStagingMemory[i], 0, rowsize, 0, &mWaterfallStagingMapped[i]) == VK_SUCCESS);
+	}
+
+	mUploadCommandBuffers.resize(slots);
+	VkCommandBufferAllocateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	bufferInfo.commandPool = mCommandPool;
+	bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	bufferInfo.commandBufferCount = slots;
+	swaggy_assert(vkAllocateCommandBuffers(mDevice, &bufferInfo, mUploadCommandBuffers.data()) == VK_SUCCESS);
+
+	//linear along the frequency axis, the shader always samples row centers so rows never bleed together
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+	swaggy_assert(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mWaterfallSampler) == VK_SUCCESS);
+
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[2] = bindings[1];
+	bindings[2].binding = 2;
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings = bindings;
+	swaggy_assert(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mWaterfallSetLayout) == VK_SUCCESS);
+
+	VkDescriptorPoolSize poolSizes[2]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = 2;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	swaggy_assert(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mWaterfallDescriptorPool) == VK_SUCCESS);
+
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = mWaterfallDescriptorPool;
+	setInfo.descriptorSetCount = 1;
+	setInfo.pSetLayouts = &mWaterfallSetLayout;
+	swaggy_assert(vkAllocateDescriptorSets(mDevice, &setInfo, &mWaterfallDescriptorSet) == VK_SUCCESS);
+
+	VkDescriptorBufferInfo paramsInfo{ mWaterfallParams, 0, sizeof(WaterfallParams) };
+	VkDescriptorImageInfo historyInfo{ mWaterfallSampler, mWaterfallImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo colormapInfo{ mWaterfallSampler, mColormapImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkWriteDescriptorSet writes[3]{};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = mWaterfallDescriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = bindings[i].descriptorType;
+	}
+	writes[0].pBufferInfo = &paramsInfo;
+	writes[1].pImageInfo = &historyInfo;
+	writes[2].pImageInfo = &colormapInfo;
+	vkUpdateDescriptorSets(mDevice, 3, writes, 0, nullptr);
+
+	CreateWaterfallPipeline();
+}
+
+void VulkanDoodler::CreateFFTCompute()
+{
+	//the whole transform sits in one workgroup's shared memory, anything that can't fit that stays on the cpu
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	if (properties.limits.maxComputeSharedMemorySize < kGpuFFTMaxSize * sizeof(float) * 2 ||
+		properties.limits.maxComputeWorkGroupInvocations < 256 ||
+		properties.limits.maxComputeWorkGroupSize[0] < 256)
+	{
+		fprintf(stderr, "gpu fft not supported on this device, sticking to the cpu one\n");
+		return;
+	}
+
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		bindings[i].binding = i; //samples, chart input, waterfall row
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings = bindings;
+	swaggy_assert(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mFFTSetLayout) == VK_SUCCESS);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mFFTSetLayout;
+	swaggy_assert(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mFFTPipelineLayout) == VK_SUCCESS);
+
+	VkShaderModule compModule = CreateShaderModule(GetShaderCode(ShaderId::FFTComp));
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = mFFTPipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	VkResult res = vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mFFTPipeline);
+	vkDestroyShaderModule(mDevice, compModule, nullptr);
+	if (res != VK_SUCCESS)
+	{
+		fprintf(stderr, "couldn't build the gpu fft pipeline (%d), sticking to the cpu one\n", (int)res);
+		mFFTPipeline = VK_NULL_HANDLE;
+		return;
+	}
+
+	uint32_t slots = (uint32_t)mUploadCommandBuffers.size();
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = slots * 3;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = slots;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	swaggy_assert(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mFFTDescriptorPool) == VK_SUCCESS);
+
+	std::vector<VkDescriptorSetLayout> layouts(slots, mFFTSetLayout);
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = mFFTDescriptorPool;
+	setInfo.descriptorSetCount = slots;
+	setInfo.pSetLayouts = layouts.data();
+	mFFTDescriptorSets.resize(slots);
+	swaggy_assert(vkAllocateDescriptorSets(mDevice, &setInfo, mFFTDescriptorSets.data()) == VK_SUCCESS);
+
+	//samples and the waterfall row belong to the slot, the chart input gets filled in per frame in RecordFFT
+	VkDeviceSize inputsize = sizeof(FFTInputHeader) + sizeof(float) * kGpuFFTMaxSize;
+	mFFTInputBuffers.resize(slots);
+	mFFTInputMemory.resize(slots);
+	mFFTInputMapped.resize(slots);
+	for (uint32_t i = 0; i < slots; ++i)
+	{
+		CreateBuffer(inputsize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			mFFTInputBuffers[i],
+			mFFTInputMemory[i]
+		);
+		swaggy_assert(vkMapMemory(mDevice, mFFTInputMemory[i], 0, inputsize, 0, &mFFTInputMapped[i]) == VK_SUCCESS);
+
+		VkDescriptorBufferInfo bufferInfos[2] =
+		{
+			{ mFFTInputBuffers[i], 0, VK_WHOLE_SIZE },
+			{ mWaterfallStaging[i], 0, VK_WHOLE_SIZE },
+		};
+		VkWriteDescriptorSet writes[2]{};
+		for (uint32_t w = 0; w < 2; ++w)
+		{
+			writes[w].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[w].dstSet = mFFTDescriptorSets[i];
+			writes[w].dstBinding = w == 0 ? 0 : 2;
+			writes[w].descriptorCount = 1;
+			writes[w].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[w].pBufferInfo = &bufferInfos[w];
+		}
+		vkUpdateDescriptorSets(mDevice, 2, writes, 0, nullptr);
+	}
+}
+
+void VulkanDoodler::CreateWaterfallPipeline()
+{
+	VkShaderModule vertModule = CreateShaderModule(GetShaderCode(ShaderId::WaterfallVert));
+	VkShaderModule fragModule = CreateShaderModule(GetShaderCode(ShaderId::WaterfallFrag));
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragModule;
+	shaderStages[1].pName = "main";
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	//the quad comes out of gl_VertexIndex, nothing to bind
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+	assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterInfo{};
+	rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterInfo.lineWidth = 1.0f;
+	rasterInfo.cullMode = VK_CULL_MODE_NONE;
+	rasterInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo msInfo{};
+	msInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	msInfo.rasterizationSamples = mMsaaSamples;
+	msInfo.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthInfo{};
+	depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthInfo.depthTestEnable = VK_FALSE;
+	depthInfo.depthWriteEnable = VK_FALSE;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlend{};
+	colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlend.attachmentCount = 1;
+	colorBlend.pAttachments = &colorBlendAttachment;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mWaterfallSetLayout;
+	swaggy_assert(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mWaterfallPipelineLayout) == VK_SUCCESS);
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &assemblyInfo;
+	pipelineInfo.pViewportState = &viewportInfo;
+	pipelineInfo.pRasterizationState = &rasterInfo;
+	pipelineInfo.pMultisampleState = &msInfo;
+	pipelineInfo.pDepthStencilState = &depthInfo;
+	pipelineInfo.pColorBlendState = &colorBlend;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = mWaterfallPipelineLayout;
+	pipelineInfo.renderPass = mRenderPass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineIndex = -1;
+	swaggy_assert(vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mWaterfallPipeline) == VK_SUCCESS);
+
+	vkDestroyShaderModule(mDevice, vertModule, nullptr);
+	vkDestroyShaderModule(mDevice, fragModule, nullptr);
 }
 
 void VulkanDoodler::CreateCommandBuffer()
@@ -499,6 +1370,50 @@ void VulkanDoodler::CreateCommandBuffer()
 	swaggy_assert(vkAllocateCommandBuffers(mDevice, &bufferInfo, mCommandBuffer.data()) == VK_SUCCESS);
 }
 
+void VulkanDoodler::CreateImageCommandBuffers()
+{
+	mImageCommandBuffers.resize(mSwapImages.size());
+	//a recreated swapchain that kept its per-image buffers keeps their fences too, see ReCreateSwapChain
+	mImagesInFlight.resize(mSwapImages.size(), VK_NULL_HANDLE);
+
+	VkCommandBufferAllocateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	bufferInfo.commandPool = mCommandPool;
+	bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	bufferInfo.commandBufferCount = (uint32_t)mImageCommandBuffers.size();
+
+	swaggy_assert(vkAllocateCommandBuffers(mDevice, &bufferInfo, mImageCommandBuffers.data()) == VK_SUCCESS);
+	CreateQueryPool();
+	RecordImageCommandBuffers();
+}
+
+void VulkanDoodler::CreateQueryPool()
+{
+	uint32_t index = 0;
+	(void)GetQueueFamilyFromFlag(mPhysicalDevice, index);
+	uint32_t count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &count, families.data());
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+
+	uint32_t validbits = families[index].timestampValidBits;
+	if (validbits == 0 || properties.limits.timestampPeriod == 0.0f)
+	{
+		return; //no timestamps on this queue, the gpu side of the profiler just stays empty
+	}
+	mTimestampMask = validbits >= 64 ? ~0ull : (1ull << validbits) - 1;
+	mTimestampPeriod = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = kQueriesPerImage * (uint32_t)mSwapImages.size();
+	swaggy_assert(vkCreateQueryPool(mDevice, &poolInfo, nullptr, &mQueryPool) == VK_SUCCESS);
+}
+
 void VulkanDoodler::CreateSyncObjects()
 {
 	mSemaphoreImageAvailable.resize(MAX_FRAMES_IN_FLIGHT);
@@ -519,29 +1434,372 @@ void VulkanDoodler::CreateSyncObjects()
 		swaggy_assert(vkCreateFence(mDevice, &fenceInfo, nullptr, &mFenceInFlight[i]) == VK_SUCCESS);
 	}
 
+	//headless targets don't go through acquire/present, each one just has a fence
+	mOffscreenFences.resize(mHeadless ? mSwapImages.size() : 0);
+	for (auto& fence : mOffscreenFences)
+	{
+		swaggy_assert(vkCreateFence(mDevice, &fenceInfo, nullptr, &fence) == VK_SUCCESS);
+	}
+
+}
+
+void VulkanDoodler::CreateOverlay()
+{
+	//imgui only needs a handful of descriptor sets, the font atlas being the main one
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = 16;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets = 16;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	swaggy_assert(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mOverlayDescriptorPool) == VK_SUCCESS);
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGui::GetIO().IniFilename = nullptr; //no imgui.ini next to the exe
+	ImGui::StyleColorsDark();
+	//chains to the callbacks WindowManager already installed, so F1 still reaches WasKeyPressed
+	ImGui_ImplGlfw_InitForVulkan(mWindow, true);
+
+	uint32_t index = 0;
+	(void)GetQueueFamilyFromFlag(mPhysicalDevice, index);
+	ImGui_ImplVulkan_InitInfo initInfo{};
+	initInfo.Instance = mInstance;
+	initInfo.PhysicalDevice = mPhysicalDevice;
+	initInfo.Device = mDevice;
+	initInfo.QueueFamily = index;
+	initInfo.Queue = mDeviceQueue;
+	initInfo.PipelineCache = VK_NULL_HANDLE;
+	initInfo.DescriptorPool = mOverlayDescriptorPool;
+	initInfo.Subpass = 0;
+	initInfo.MinImageCount = 2;
+	initInfo.ImageCount = (uint32_t)mSwapImages.size();
+	initInfo.MSAASamples = mMsaaSamples;
+	swaggy_assert(ImGui_ImplVulkan_Init(&initInfo, mRenderPass));
+
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+	ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
+	EndSingleTimeCommands(commandBuffer);
+	ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
 
 void VulkanDoodler::ReCreateSwapChain()
 {
-	vkDeviceWaitIdle(mDevice);
-	DestroySwapChain();
+	//no vkDeviceWaitIdle here, the old swapchain gets handed to the new one and its views, framebuffers
+	//and command buffers get parked until the frames that were in flight with them have signaled
+	RetiredSwapChain retired;
+	retired.frame = mFrameCount;
+	retired.swapchain = mSwapChain;
+	retired.imageViews.swap(mImageViews);
+	retired.frameBuffers.swap(mFrameBuffers);
+	retired.commandBuffers.swap(mImageCommandBuffers);
+	retired.queryPool = mQueryPool;
+	mQueryPool = VK_NULL_HANDLE;
+	if (mColorImage != VK_NULL_HANDLE)
+	{
+		retired.imageViews.push_back(mColorImageView);
+		retired.images.push_back(mColorImage);
+		retired.imageMemory.push_back(mColorImageMemory);
+		mColorImage = VK_NULL_HANDLE;
+	}
+	retired.imageViews.push_back(mDepthImageView);
+	retired.images.push_back(mDepthImage);
+	retired.imageMemory.push_back(mDepthImageMemory);
+	mDepthImage = VK_NULL_HANDLE;
+
+	CreateSwapChain();
+	CreateImageViews();
+	CreateRenderTargets();
+	CreateFrameBuffers();
+	//the bars follow the pixel columns, every image picks the new layout up the next time it's written
+	UpdateChartLayout();
+
+	//the image count can change with the swapchain, so the per-image stuff gets rebuilt too. when it doesn't, the
+	//chart input, vertex and camera buffers stay, and so do the fences of the frames that might still be reading
+	//them, the next Update on each image waits on that like it always does before writing into them
+	if (mVertexBuffers.size() != mSwapImages.size())
+	{
+		mImagesInFlight.clear(); //the old buffers retire with the swapchain, the new ones aren't in use yet
+		retired.chartInputBuffers.swap(mChartInputBuffers);
+		retired.chartInputMemory.swap(mChartInputMemory);
+		retired.vertexBuffers.swap(mVertexBuffers);
+		retired.vertexBufferMemory.swap(mVertexBufferMemory);
+		retired.chartDescriptorSets.swap(mChartDescriptorSets);
+		retired.orbCameraBuffers.swap(mOrbCameraBuffers);
+		retired.orbCameraMemory.swap(mOrbCameraMemory);
+		retired.orbDescriptorSets.swap(mOrbDescriptorSets);
+		mChartInputMapped.clear();
+		mOrbCameraMapped.clear();
+		CreateChartBuffers();
+		CreateOrbBuffers();
+	}
+	CreateImageCommandBuffers();
+
+	mRetiredSwapChains.push_back(std::move(retired));
+	mResizePending = false;
+}
+
+void VulkanDoodler::ReleaseRetiredSwapChains(bool force)
+{
+	//called after the fence wait at the top of Update, by then every frame submitted
+	//MAX_FRAMES_IN_FLIGHT frames ago or earlier is done with the old images
+	while (!mRetiredSwapChains.empty() && (force || mFrameCount >= mRetiredSwapChains.front().frame + MAX_FRAMES_IN_FLIGHT))
+	{
+		RetiredSwapChain& retired = mRetiredSwapChains.front();
+		if (!retired.commandBuffers.empty())
+		{
+			vkFreeCommandBuffers(mDevice, mCommandPool, (uint32_t)retired.commandBuffers.size(), retired.commandBuffers.data());
+		}
+		if (retired.queryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(mDevice, retired.queryPool, nullptr);
+		}
+		for (auto framebuffer : retired.frameBuffers)
+		{
+			vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+		}
+		for (auto imageview : retired.imageViews)
+		{
+			vkDestroyImageView(mDevice, imageview, nullptr);
+		}
+		for (size_t i = 0; i < retired.images.size(); ++i)
+		{
+			vkDestroyImage(mDevice, retired.images[i], nullptr);
+			vkFreeMemory(mDevice, retired.imageMemory[i], nullptr);
+		}
+		if (!retired.chartDescriptorSets.empty())
+		{
+			vkFreeDescriptorSets(mDevice, mChartDescriptorPool, (uint32_t)retired.chartDescriptorSets.size(), retired.chartDescriptorSets.data());
+		}
+		for (size_t i = 0; i < retired.chartInputBuffers.size(); ++i)
+		{
+			vkUnmapMemory(mDevice, retired.chartInputMemory[i]);
+			vkDestroyBuffer(mDevice, retired.chartInputBuffers[i], nullptr);
+			vkFreeMemory(mDevice, retired.chartInputMemory[i], nullptr);
+		}
+		for (size_t i = 0; i < retired.vertexBuffers.size(); ++i)
+		{
+			vkDestroyBuffer(mDevice, retired.vertexBuffers[i], nullptr);
+			vkFreeMemory(mDevice, retired.vertexBufferMemory[i], nullptr);
+		}
+		if (!retired.orbDescriptorSets.empty())
+		{
+			vkFreeDescriptorSets(mDevice, mOrbDescriptorPool, (uint32_t)retired.orbDescriptorSets.size(), retired.orbDescriptorSets.data());
+		}
+		for (size_t i = 0; i < retired.orbCameraBuffers.size(); ++i)
+		{
+			vkUnmapMemory(mDevice, retired.orbCameraMemory[i]);
+			vkDestroyBuffer(mDevice, retired.orbCameraBuffers[i], nullptr);
+			vkFreeMemory(mDevice, retired.orbCameraMemory[i], nullptr);
+		}
+		vkDestroySwapchainKHR(mDevice, retired.swapchain, nullptr); //null after a view switch, which is fine
+		mRetiredSwapChains.pop_front();
+	}
+}
+
+void VulkanDoodler::DestroySwapChain()
+{
+	for (auto framebuffer : mFrameBuffers)
+	{
+		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+	}
+	for (auto imageview : mImageViews)
+	{
+		vkDestroyImageView(mDevice, imageview, nullptr);
+	}
+	DestroyRenderTargets();
+	if (mHeadless)
+	{
+		DestroyOffscreenTargets();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+	}
+}
+
+void VulkanDoodler::DestroyOffscreenTargets()
+{
+	for (size_t i = 0; i < mSwapImages.size(); ++i)
+	{
+		vkDestroyImage(mDevice, mSwapImages[i], nullptr);
+		vkFreeMemory(mDevice, mOffscreenImageMemory[i], nullptr);
+	}
+	for (size_t i = 0; i < mReadbackBuffers.size(); ++i)
+	{
+		vkUnmapMemory(mDevice, mReadbackMemory[i]);
+		vkDestroyBuffer(mDevice, mReadbackBuffers[i], nullptr);
+		vkFreeMemory(mDevice, mReadbackMemory[i], nullptr);
+	}
+	mSwapImages.clear();
+	mOffscreenImageMemory.clear();
+	mReadbackBuffers.clear();
+	mReadbackMemory.clear();
+	mReadbackMapped.clear();
+}
+
+void VulkanDoodler::DestroyRenderTargets()
+{
+	if (mColorImage != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(mDevice, mColorImageView, nullptr);
+		vkDestroyImage(mDevice, mColorImage, nullptr);
+		vkFreeMemory(mDevice, mColorImageMemory, nullptr);
+		mColorImage = VK_NULL_HANDLE;
+	}
+	if (mDepthImage != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(mDevice, mDepthImageView, nullptr);
+		vkDestroyImage(mDevice, mDepthImage, nullptr);
+		vkFreeMemory(mDevice, mDepthImageMemory, nullptr);
+		mDepthImage = VK_NULL_HANDLE;
+	}
+}
+
+void VulkanDoodler::DestroyChartBuffers()
+{
+	if (!mChartDescriptorSets.empty())
+	{
+		vkFreeDescriptorSets(mDevice, mChartDescriptorPool, (uint32_t)mChartDescriptorSets.size(), mChartDescriptorSets.data());
+	}
+	for (size_t i = 0; i < mChartInputBuffers.size(); ++i)
+	{
+		vkUnmapMemory(mDevice, mChartInputMemory[i]);
+		vkDestroyBuffer(mDevice, mChartInputBuffers[i], nullptr);
+		vkFreeMemory(mDevice, mChartInputMemory[i], nullptr);
+	}
+	for (size_t i = 0; i < mVertexBuffers.size(); ++i)
+	{
+		vkDestroyBuffer(mDevice, mVertexBuffers[i], nullptr);
+		vkFreeMemory(mDevice, mVertexBufferMemory[i], nullptr);
+	}
+	mChartInputBuffers.clear();
+	mChartInputMemory.clear();
+	mChartInputMapped.clear();
+	mChartLayoutWritten.clear();
+	mVertexBuffers.clear();
+	mVertexBufferMemory.clear();
+	mChartDescriptorSets.clear();
+}
+
+void VulkanDoodler::DestroyOrbBuffers()
+{
+	if (!mOrbDescriptorSets.empty())
+	{
+		vkFreeDescriptorSets(mDevice, mOrbDescriptorPool, (uint32_t)mOrbDescriptorSets.size(), mOrbDescriptorSets.data());
+	}
+	for (size_t i = 0; i < mOrbCameraBuffers.size(); ++i)
+	{
+		vkUnmapMemory(mDevice, mOrbCameraMemory[i]);
+		vkDestroyBuffer(mDevice, mOrbCameraBuffers[i], nullptr);
+		vkFreeMemory(mDevice, mOrbCameraMemory[i], nullptr);
+	}
+	mOrbCameraBuffers.clear();
+	mOrbCameraMemory.clear();
+	mOrbCameraMapped.clear();
+	mOrbDescriptorSets.clear();
+}
+
+void VulkanDoodler::DestroyOrb()
+{
+	vkDestroyPipeline(mDevice, mOrbPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mOrbPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(mDevice, mOrbDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mOrbSetLayout, nullptr);
+	vkDestroyBuffer(mDevice, mOrbVertexBuffer, nullptr);
+	vkFreeMemory(mDevice, mOrbVertexBufferMemory, nullptr);
+	vkDestroyBuffer(mDevice, mOrbIndexBuffer, nullptr);
+	vkFreeMemory(mDevice, mOrbIndexBufferMemory, nullptr);
+}
+
+void VulkanDoodler::DestroyChartState()
+{
+	vkDestroyBuffer(mDevice, mChartState, nullptr);
+	vkFreeMemory(mDevice, mChartStateMemory, nullptr);
+}
+
+void VulkanDoodler::DestroyChartCompute()
+{
+	vkDestroyPipeline(mDevice, mChartPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mChartPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(mDevice, mChartDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mChartSetLayout, nullptr);
+}
+
+void VulkanDoodler::DestroyFFTCompute()
+{
+	for (size_t i = 0; i < mFFTInputBuffers.size(); ++i)
+	{
+		vkUnmapMemory(mDevice, mFFTInputMemory[i]);
+		vkDestroyBuffer(mDevice, mFFTInputBuffers[i], nullptr);
+		vkFreeMemory(mDevice, mFFTInputMemory[i], nullptr);
+	}
+	mFFTInputBuffers.clear();
+	mFFTInputMemory.clear();
+	mFFTInputMapped.clear();
+	mFFTDescriptorSets.clear(); //they go away with the pool
+	//all null if the device couldn't run it, which vkDestroy* is fine with
+	vkDestroyDescriptorPool(mDevice, mFFTDescriptorPool, nullptr);
+	vkDestroyPipeline(mDevice, mFFTPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mFFTPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mFFTSetLayout, nullptr);
+	mFFTPipeline = VK_NULL_HANDLE;
+}
 
-	CreateSwapChain();
-	CreateImageViews();
-	CreateFrameBuffers();
+void VulkanDoodler::DestroyWaterfall()
+{
+	vkDestroyPipeline(mDevice, mWaterfallPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mWaterfallPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(mDevice, mWaterfallDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mWaterfallSetLayout, nullptr);
+	vkDestroySampler(mDevice, mWaterfallSampler, nullptr);
+	vkDestroyImageView(mDevice, mWaterfallImageView, nullptr);
+	vkDestroyImage(mDevice, mWaterfallImage, nullptr);
+	vkFreeMemory(mDevice, mWaterfallImageMemory, nullptr);
+	vkDestroyImageView(mDevice, mColormapImageView, nullptr);
+	vkDestroyImage(mDevice, mColormapImage, nullptr);
+	vkFreeMemory(mDevice, mColormapImageMemory, nullptr);
+	vkDestroyBuffer(mDevice, mWaterfallParams, nullptr);
+	vkFreeMemory(mDevice, mWaterfallParamsMemory, nullptr);
+	for (size_t i = 0; i < mWaterfallStaging.size(); ++i)
+	{
+		vkUnmapMemory(mDevice, mWaterfallStagingMemory[i]);
+		vkDestroyBuffer(mDevice, mWaterfallStaging[i], nullptr);
+		vkFreeMemory(mDevice, mWaterfallStagingMemory[i], nullptr);
+	}
+	mWaterfallStaging.clear();
+	mWaterfallStagingMemory.clear();
+	mWaterfallStagingMapped.clear();
+	mUploadCommandBuffers.clear(); //they go away with the command pool
 }
 
-void VulkanDoodler::DestroySwapChain()
+void VulkanDoodler::DestroyImageCommandBuffers()
 {
-	for (auto framebuffer : mFrameBuffers)
+	if (!mImageCommandBuffers.empty())
 	{
-		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+		vkFreeCommandBuffers(mDevice, mCommandPool, (uint32_t)mImageCommandBuffers.size(), mImageCommandBuffers.data());
 	}
-	for (auto imageview : mImageViews)
+	mImageCommandBuffers.clear();
+	mImagesInFlight.clear();
+	if (mQueryPool != VK_NULL_HANDLE)
 	{
-		vkDestroyImageView(mDevice, imageview, nullptr);
+		vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+		mQueryPool = VK_NULL_HANDLE;
 	}
-	vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+}
+
+void VulkanDoodler::DestroyOverlay()
+{
+	if (mOverlayDescriptorPool == VK_NULL_HANDLE)
+		return;
+	ImGui_ImplVulkan_Shutdown();
+	ImGui_ImplGlfw_Shutdown();
+	ImGui::DestroyContext();
+	vkDestroyDescriptorPool(mDevice, mOverlayDescriptorPool, nullptr);
+	mOverlayDescriptorPool = VK_NULL_HANDLE;
 }
 
 bool VulkanDoodler::IsMinimized()
@@ -554,31 +1812,117 @@ bool VulkanDoodler::IsMinimized()
 
 void VulkanDoodler::UpdateChart(const std::vector<float>& Chart)
 {
-	auto chart = GenerateChartFromSample(Chart);
-	uint32_t buffersize = sizeof(chart[0]) * chart.size();
+	ScopedTimer timer(mProfiler, ProfileStage::UpdateChart);
+	mGpuFFTActive = false;
+	//just keep the raw magnitudes around, they land in the mapped input buffer of whichever image gets acquired next
+	//all the smoothing and scaling happens in chart.comp
+	size_t count = glm::min(Chart.size(), mChartMagnitudes.size());
+	std::copy(Chart.begin(), Chart.begin() + count, mChartMagnitudes.begin());
+	std::fill(mChartMagnitudes.begin() + count, mChartMagnitudes.end(), 0.0f);
+
+	//same for the next waterfall row, in the bars' dB scale. the row has a fixed width, so with more bars
+	//than texels each texel takes the loudest of its bars
+	//the max happens on the magnitudes, the log only once per texel in a vectorized pass after
+	size_t rowbins = mWaterfallRow.size();
+	for (size_t i = 0; i < rowbins; ++i)
+	{
+		size_t first = i * count / rowbins;
+		size_t last = glm::max(first + 1, (i + 1) * count / rowbins);
+		float peak = 0.0f;
+		for (size_t bin = first; bin < last && bin < count; ++bin)
+			peak = glm::max(peak, Chart[bin]);
+		mWaterfallLevels[i] = peak;
+	}
+	ToChartLevels(mWaterfallLevels.data(), mWaterfallLevels.data(), rowbins);
+	for (size_t i = 0; i < rowbins; ++i)
+	{
+		mWaterfallRow[i] = (uint16_t)glm::packHalf1x16(mWaterfallLevels[i]);
+	}
+	mWaterfallDirty = true;
+}
 
-	//staging buffer
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(buffersize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer,
-		stagingBufferMemory
-	);
+bool VulkanDoodler::SupportsGpuFFT(size_t size)
+{
+	bool poweroftwo = size != 0 && (size & (size - 1)) == 0;
+	return mFFTPipeline != VK_NULL_HANDLE && poweroftwo && size >= 4 && size <= kGpuFFTMaxSize;
+}
 
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, buffersize, 0, &data);
-	memcpy(data, chart.data(), (size_t)buffersize);
-	vkUnmapMemory(mDevice, stagingBufferMemory);
+void VulkanDoodler::UpdateSamples(const complex_sample& samples, WindowFunction window)
+{
+	ScopedTimer timer(mProfiler, ProfileStage::UpdateChart);
+	swaggy_assert(SupportsGpuFFT(samples.size()));
+	//only the real part, that's all the capture ever fills in
+	mFFTSamples.resize(samples.size());
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		mFFTSamples[i] = samples[i].real();
+	}
+	mFFTWindow = window;
+	mGpuFFTActive = true;
+	mWaterfallDirty = true;
+}
 
-	CopyBuffer(mVertexBuffer, stagingBuffer, buffersize);
+void VulkanDoodler::ReadbackMagnitudes(uint32_t target, std::vector<float>& magnitudes)
+{
+	swaggy_assert(mHeadless && target < OffscreenTargetCount());
+	vkWaitForFences(mDevice, 1, &mOffscreenFences[target], VK_TRUE, UINT64_MAX);
+	const float* input = (const float*)((const uint8_t*)mChartInputMapped[target] + sizeof(ChartInputHeader));
+	magnitudes.assign(input, input + mChartBins);
+}
 
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+void VulkanDoodler::SetPreRecordedCommands(bool enable)
+{
+	//the per-image command buffers are always kept recorded, so this is just picking which ones get submitted
+	mPreRecordCommands = enable;
+}
+
+void VulkanDoodler::SetViewMode(ViewMode mode)
+{
+	if (mode == mViewMode)
+		return;
+	mViewMode = mode;
+	//the pre-recorded buffers bake in the draws, so they get swapped out for fresh ones. the old ones can still
+	//be in flight, they get parked with the retired swapchains (minus the swapchain) instead of waiting on them.
+	//the query pool stays, each image's new buffer only runs after the old one's fence anyway
+	RetiredSwapChain retired;
+	retired.frame = mFrameCount;
+	retired.commandBuffers.swap(mImageCommandBuffers);
+	mRetiredSwapChains.push_back(std::move(retired));
+
+	mImageCommandBuffers.resize(mSwapImages.size());
+	VkCommandBufferAllocateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	bufferInfo.commandPool = mCommandPool;
+	bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	bufferInfo.commandBufferCount = (uint32_t)mImageCommandBuffers.size();
+	swaggy_assert(vkAllocateCommandBuffers(mDevice, &bufferInfo, mImageCommandBuffers.data()) == VK_SUCCESS);
+	RecordImageCommandBuffers();
+}
+
+void VulkanDoodler::SetChartBins(uint32_t bins)
+{
+	swaggy_assert(bins >= 2);
+	if (bins == mChartBins)
+		return;
+	//the state, vertex and index buffers and every set pointing at them all change size. it's a knob that gets
+	//touched once in a while, so just let the queue run dry like the uploads do instead of retiring all of it
+	vkQueueWaitIdle(mDeviceQueue);
+	mChartBins = bins;
+	DestroyOrbBuffers();
+	DestroyChartBuffers();
+	DestroyChartState();
+	vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
+	vkFreeMemory(mDevice, mIndexBufferMemory, nullptr);
+
+	CreateChartState();
+	UpdateChartLayout();
+	CreateChartBuffers();
+	CreateIndexBuffer();
+	CreateOrbBuffers();
+	RecordImageCommandBuffers();
 }
 
-void VulkanDoodler::RecordCommandBuffer(VkCommandBuffer commandbuffer, uint32_t imageIndex)
+void VulkanDoodler::RecordCommandBuffer(VkCommandBuffer commandbuffer, uint32_t imageIndex, bool withOverlay)
 {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -587,24 +1931,40 @@ void VulkanDoodler::RecordCommandBuffer(VkCommandBuffer commandbuffer, uint32_t
 
 	swaggy_assert(vkBeginCommandBuffer(commandbuffer, &beginInfo) == VK_SUCCESS);
 
+	uint32_t firstquery = imageIndex * kQueriesPerImage;
+	if (mQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandbuffer, mQueryPool, firstquery, kQueriesPerImage);
+		vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, firstquery + kQueryFrameBegin);
+	}
+
+	//chart compute: raw magnitudes in, smoothed/peak-held vertices out
+	//the state buffer is shared by every image, so wait for whichever frame touched it last (the orb reads it too)
+	BufferBarrier(commandbuffer, mChartState, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mChartPipeline);
+	vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mChartPipelineLayout, 0, 1, &mChartDescriptorSets[imageIndex], 0, nullptr);
+	vkCmdDispatch(commandbuffer, 1, 1, 1);
+	BufferBarrier(commandbuffer, mVertexBuffers[imageIndex], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	BufferBarrier(commandbuffer, mChartState, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = mRenderPass;
 	renderPassInfo.framebuffer = mFrameBuffers[imageIndex];
 	renderPassInfo.renderArea.offset = { 0, 0 };
 	renderPassInfo.renderArea.extent = mSwapExtent;
-	VkClearValue clearcolor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearcolor;
+	//color, depth, resolve (which isn't cleared, it's there to keep the indices lined up)
+	VkClearValue clearvalues[3]{};
+	clearvalues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearvalues[1].depthStencil = { 1.0f, 0 };
+	renderPassInfo.clearValueCount = mMsaaSamples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+	renderPassInfo.pClearValues = clearvalues;
 
 	vkCmdBeginRenderPass(commandbuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
 
-	VkBuffer vertexbuffers[] = { mVertexBuffer };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandbuffer, 0, 1, vertexbuffers, offsets);
-	vkCmdBindIndexBuffer(commandbuffer, mIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-	
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
@@ -618,13 +1978,260 @@ void VulkanDoodler::RecordCommandBuffer(VkCommandBuffer commandbuffer, uint32_t
 	scissor.offset = { 0, 0 };
 	scissor.extent = mSwapExtent;
 	vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
-	vkCmdDrawIndexed(commandbuffer, (uint32_t)1024 * 3, 1, 0, 0, 0); //HARDOCDED AF
+
+	if (mViewMode == ViewMode::Orb)
+	{
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mOrbPipeline);
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mOrbPipelineLayout, 0, 1, &mOrbDescriptorSets[imageIndex], 0, nullptr);
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandbuffer, 0, 1, &mOrbVertexBuffer, &offset);
+		vkCmdBindIndexBuffer(commandbuffer, mOrbIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(commandbuffer, mOrbIndexCount, 1, 0, 0, 0);
+	}
+	else
+	{
+		//history first, the bars go on top
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mWaterfallPipeline);
+		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mWaterfallPipelineLayout, 0, 1, &mWaterfallDescriptorSet, 0, nullptr);
+		vkCmdDraw(commandbuffer, 6, 1, 0, 0);
+
+		vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
+		VkBuffer vertexbuffers[] = { mVertexBuffers[imageIndex] };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandbuffer, 0, 1, vertexbuffers, offsets);
+		vkCmdBindIndexBuffer(commandbuffer, mIndexBuffer, 0, mIndexType);
+		//the index buffer covers every bin, only the part for the layout's bars gets drawn
+		uint32_t bars = (uint32_t)mChartLayout.size();
+		uint32_t indexcount = glm::min(mIndexCount, bars > 1 ? (bars - 1) * 6 : 0);
+		vkCmdDrawIndexed(commandbuffer, indexcount, 1, 0, 0, 0);
+		//peak ticks, same quads laid out right after the bars
+		vkCmdDrawIndexed(commandbuffer, indexcount, 1, 0, 2 * bars, 0);
+	}
+	if (withOverlay)
+	{
+		//same subpass, drawn over the chart
+		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandbuffer);
+	}
 	
 	vkCmdEndRenderPass(commandbuffer);
+	if (mQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, firstquery + kQueryRenderPassEnd);
+	}
+
+	if (mHeadless)
+	{
+		//the render pass left the image in TRANSFER_SRC_OPTIMAL, copy it out to the mapped readback buffer
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { mSwapExtent.width, mSwapExtent.height, 1 };
+		vkCmdCopyImageToBuffer(commandbuffer, mSwapImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mReadbackBuffers[imageIndex], 1, &region);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = mReadbackBuffers[imageIndex];
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+	if (mQueryPool != VK_NULL_HANDLE)
+	{
+		//written even when there's no transfer, otherwise the results never become available
+		vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, firstquery + kQueryTransferEnd);
+	}
+
+	swaggy_assert(vkEndCommandBuffer(commandbuffer) == VK_SUCCESS);
+}
+
+void VulkanDoodler::RecordImageCommandBuffers()
+{
+	//everything in here is static until the swapchain gets rebuilt, the only per-frame data is the chart
+	//which goes through the persistently mapped vertex buffers
+	for (uint32_t i = 0; i < (uint32_t)mImageCommandBuffers.size(); ++i)
+	{
+		RecordCommandBuffer(mImageCommandBuffers[i], i);
+	}
+}
+
+void VulkanDoodler::WriteChartInput(uint32_t imageIndex)
+{
+	ChartInputHeader header{ mChartStyle, mChartBins };
+	uint8_t* input = (uint8_t*)mChartInputMapped[imageIndex];
+	memcpy(input, &header, sizeof(header));
+	//with the gpu fft on, the magnitudes get written by fft.comp in the upload command buffer instead
+	if (!mGpuFFTActive)
+	{
+		memcpy(input + sizeof(header), mChartMagnitudes.data(), sizeof(float) * mChartBins);
+	}
+	//only when it changed, it's up to 16 bytes a bin
+	if (mChartLayoutWritten[imageIndex] != mChartLayoutVersion)
+	{
+		ChartLayoutHeader layoutheader{ (uint32_t)mChartLayout.size() };
+		memcpy(input + mChartLayoutOffset, &layoutheader, sizeof(layoutheader));
+		memcpy(input + mChartLayoutOffset + sizeof(layoutheader), mChartLayout.data(), sizeof(ChartBar) * mChartLayout.size());
+		mChartLayoutWritten[imageIndex] = mChartLayoutVersion;
+	}
+}
+
+void VulkanDoodler::UpdateChartLayout()
+{
+	uint32_t columns = (uint32_t)(mSwapExtent.width * kChartWidth);
+	BuildChartLayout(mChartBins, columns, mChartLayout);
+	++mChartLayoutVersion;
+}
+
+void VulkanDoodler::WriteOrbCamera(uint32_t imageIndex)
+{
+	//vulkan's clip space has y pointing down, flipping it here keeps the mesh winding the same as in glm
+	float aspect = (float)mSwapExtent.width / (float)glm::max(mSwapExtent.height, 1u);
+	glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(45.0f), aspect, 0.1f, 10.0f);
+	proj[1][1] *= -1.0f;
+	glm::mat4 view = glm::lookAtRH(glm::vec3(0.0f, 0.6f, 3.2f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	OrbCamera camera{};
+	camera.viewProj = proj * view;
+	camera.model = glm::rotate(glm::mat4(1.0f), mOrbTime * kOrbSpin, glm::vec3(0.0f, 1.0f, 0.0f));
+	camera.lightDir = glm::vec4(glm::normalize(glm::vec3(-0.4f, 0.8f, 0.6f)), 0.0f);
+	camera.amplitude = kOrbAmplitude;
+	camera.bins = mChartBins;
+	camera.time = mOrbTime;
+	camera.pulse = mBeatPulse;
+	memcpy(mOrbCameraMapped[imageIndex], &camera, sizeof(camera));
+}
+
+void VulkanDoodler::RecordFFT(VkCommandBuffer commandbuffer, uint32_t slot, uint32_t imageIndex)
+{
+	FFTInputHeader header{};
+	header.size = (uint32_t)mFFTSamples.size();
+	while (((size_t)1 << header.log2size) < mFFTSamples.size())
+		++header.log2size;
+	header.window = (uint32_t)mFFTWindow;
+	header.rowBins = kWaterfallBins;
+	uint8_t* input = (uint8_t*)mFFTInputMapped[slot];
+	memcpy(input, &header, sizeof(header));
+	memcpy(input + sizeof(header), mFFTSamples.data(), sizeof(float) * mFFTSamples.size());
+
+	//the slot's last submit is done, so its set can be repointed at this frame's chart input
+	VkDescriptorBufferInfo chartInfo{ mChartInputBuffers[imageIndex], 0, mChartLayoutOffset };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = mFFTDescriptorSets[slot];
+	write.dstBinding = 1;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &chartInfo;
+	vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+
+	vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mFFTPipeline);
+	vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mFFTPipelineLayout, 0, 1, &mFFTDescriptorSets[slot], 0, nullptr);
+	vkCmdDispatch(commandbuffer, 1, 1, 1);
+
+	//magnitudes on to the chart pass (and the host for ReadbackMagnitudes), the row on to the image copy
+	BufferBarrier(commandbuffer, mChartInputBuffers[imageIndex], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT);
+	BufferBarrier(commandbuffer, mWaterfallStaging[slot], VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+}
+
+bool VulkanDoodler::RecordUploads(uint32_t slot, uint32_t imageIndex)
+{
+	if (!mWaterfallDirty)
+		return false;
+	mWaterfallDirty = false;
+
+	//the caller already waited on this slot's fence, so the staging row and the command buffer are free
+	if (!mGpuFFTActive)
+	{
+		memcpy(mWaterfallStagingMapped[slot], mWaterfallRow.data(), mWaterfallRow.size() * sizeof(uint16_t));
+	}
+	mWaterfallHead = (mWaterfallHead + 1) % mWaterfallRows;
+
+	VkCommandBuffer commandbuffer = mUploadCommandBuffers[slot];
+	swaggy_assert(vkResetCommandBuffer(commandbuffer, 0) == VK_SUCCESS);
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	swaggy_assert(vkBeginCommandBuffer(commandbuffer, &beginInfo) == VK_SUCCESS);
+
+	if (mGpuFFTActive)
+	{
+		RecordFFT(commandbuffer, slot, imageIndex);
+	}
+
+	//the previous frame's draw may still be sampling the history, SHADER_READ_ONLY -> TRANSFER_DST keeps the contents
+	ImageBarrier(commandbuffer, mWaterfallImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	BufferBarrier(commandbuffer, mWaterfallParams, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	//just the one row, never the whole texture
+	VkBufferImageCopy region{};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, (int32_t)mWaterfallHead, 0 };
+	region.imageExtent = { kWaterfallBins, 1, 1 };
+	vkCmdCopyBufferToImage(commandbuffer, mWaterfallStaging[slot], mWaterfallImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkCmdUpdateBuffer(commandbuffer, mWaterfallParams, offsetof(WaterfallParams, head), sizeof(uint32_t), &mWaterfallHead);
+
+	ImageBarrier(commandbuffer, mWaterfallImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	BufferBarrier(commandbuffer, mWaterfallParams, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
 	swaggy_assert(vkEndCommandBuffer(commandbuffer) == VK_SUCCESS);
+	return true;
+}
+
+void VulkanDoodler::CollectTimestamps(uint32_t imageIndex)
+{
+	//only called once the image's fence has signaled, so this never waits
+	if (mQueryPool == VK_NULL_HANDLE)
+		return;
+
+	uint64_t timestamps[kQueriesPerImage];
+	VkResult res = vkGetQueryPoolResults(mDevice, mQueryPool, imageIndex * kQueriesPerImage, kQueriesPerImage,
+		sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (res != VK_SUCCESS)
+		return; //VK_NOT_READY the first time around
+
+	auto elapsedms = [&](TimestampQuery from, TimestampQuery to)
+	{
+		uint64_t ticks = (timestamps[to] - timestamps[from]) & mTimestampMask;
+		return (float)(ticks * (double)mTimestampPeriod / 1e6);
+	};
+	mProfiler.Add(ProfileStage::GpuFrame, elapsedms(kQueryFrameBegin, kQueryTransferEnd));
+	mProfiler.Add(ProfileStage::GpuRenderPass, elapsedms(kQueryFrameBegin, kQueryRenderPassEnd));
+	if (mHeadless)
+	{
+		mProfiler.Add(ProfileStage::GpuTransfer, elapsedms(kQueryRenderPassEnd, kQueryTransferEnd));
+	}
 }
 
 void VulkanDoodler::CopyBuffer(VkBuffer dst, VkBuffer src, VkDeviceSize size)
+{
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+
+	VkBufferCopy copy{};
+	copy.dstOffset = 0;
+	copy.srcOffset = 0;
+	copy.size = size;
+	vkCmdCopyBuffer(commandBuffer, src, dst, 1, &copy);
+
+	EndSingleTimeCommands(commandBuffer);
+}
+
+VkCommandBuffer VulkanDoodler::BeginSingleTimeCommands()
 {
 	VkCommandBufferAllocateInfo allocinfo{};
 	allocinfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -640,13 +2247,11 @@ void VulkanDoodler::CopyBuffer(VkBuffer dst, VkBuffer src, VkDeviceSize size)
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	return commandBuffer;
+}
 
-	VkBufferCopy copy{};
-	copy.dstOffset = 0;
-	copy.srcOffset = 0;
-	copy.size = size;
-	vkCmdCopyBuffer(commandBuffer, src, dst, 1, &copy);
-
+void VulkanDoodler::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
+{
 	vkEndCommandBuffer(commandBuffer);
 
 	VkSubmitInfo submitInfo{};
@@ -678,16 +2283,124 @@ void VulkanDoodler::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Vk
 	vkMemInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
 
 	swaggy_assert(vkAllocateMemory(mDevice, &vkMemInfo, nullptr, &memory) == VK_SUCCESS);
+	++mAllocationCount;
 
 	vkBindBufferMemory(mDevice, buffer, memory, 0);
 }
 
-VkShaderModule VulkanDoodler::CreateShaderModule(const std::vector<char>& code)
+void VulkanDoodler::CreateStaticBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	CreateBuffer(size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer,
+		stagingBufferMemory
+	);
+
+	void* mapped;
+	vkMapMemory(mDevice, stagingBufferMemory, 0, size, 0, &mapped);
+	memcpy(mapped, data, (size_t)size);
+	vkUnmapMemory(mDevice, stagingBufferMemory);
+
+	CreateBuffer(size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		buffer,
+		memory
+	);
+	CopyBuffer(buffer, stagingBuffer, size);
+
+	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
+	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+}
+
+void VulkanDoodler::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& memory,
+	VkSampleCountFlagBits samples)
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = samples;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	swaggy_assert(vkCreateImage(mDevice, &imageInfo, nullptr, &image) == VK_SUCCESS);
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	swaggy_assert(vkAllocateMemory(mDevice, &allocInfo, nullptr, &memory) == VK_SUCCESS);
+	++mAllocationCount;
+	vkBindImageMemory(mDevice, image, memory, 0);
+}
+
+VkImageView VulkanDoodler::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect)
+{
+	VkImageViewCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.image = image;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format = format;
+	createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.subresourceRange.aspectMask = aspect;
+	createInfo.subresourceRange.baseMipLevel = 0;
+	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.baseArrayLayer = 0;
+	createInfo.subresourceRange.layerCount = 1;
+
+	VkImageView view;
+	swaggy_assert(vkCreateImageView(mDevice, &createInfo, nullptr, &view) == VK_SUCCESS);
+	return view;
+}
+
+VkSampleCountFlagBits VulkanDoodler::ChooseSampleCount()
+{
+	//4x is where the orb's silhouette stops crawling, anything past that isn't worth the bandwidth
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	if (counts & VK_SAMPLE_COUNT_4_BIT)
+		return VK_SAMPLE_COUNT_4_BIT;
+	if (counts & VK_SAMPLE_COUNT_2_BIT)
+		return VK_SAMPLE_COUNT_2_BIT;
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+VkFormat VulkanDoodler::ChooseDepthFormat()
+{
+	//D32 is the one that's everywhere except on some older amd, the stencil ones are fallbacks
+	const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+	for (VkFormat format : candidates)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, format, &properties);
+		if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			return format;
+	}
+	swaggy_assert(false && "no depth format");
+	return VK_FORMAT_UNDEFINED;
+}
+
+VkShaderModule VulkanDoodler::CreateShaderModule(const ShaderCode& code)
 {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = (uint32_t*)code.data();
+	createInfo.codeSize = code.size;
+	createInfo.pCode = code.code;
 	VkShaderModule shaderModule = 0;
 	swaggy_assert(vkCreateShaderModule(mDevice, &createInfo, nullptr, &shaderModule) == VK_SUCCESS);
 	return shaderModule;
@@ -709,7 +2422,7 @@ bool VulkanDoodler::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	std::vector<VkExtensionProperties> supported(supportedcount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &supportedcount, supported.data());
 
-	for (auto& extension : deviceExtensions)
+	for (auto& extension : GetRequiredDeviceExtensions())
 	{
 		bool found = false;
 		for (auto& support : supported)
@@ -722,7 +2435,7 @@ bool VulkanDoodler::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 		}
 		if (!found)
 		{
-			printf("unsupported extension, prolly crash: %s\n", extension);
+			fprintf(stderr, "unsupported extension, prolly crash: %s\n", extension);
 			return false;
 		}
 
@@ -840,10 +2553,10 @@ void VulkanDoodler::CreateInstance()
 	vkEnumerateInstanceExtensionProperties(nullptr, &extensioncount, extensions.data());
 
 #ifndef NDEBUG
-	printf("vulkan initialized with %d extensions:\n", extensioncount);
+	fprintf(stderr, "vulkan initialized with %d extensions:\n", extensioncount);
 	for (uint32_t i = 0; i < extensioncount; ++i)
 	{
-		printf("%d, %s\n", i, extensions[i].extensionName);
+		fprintf(stderr, "%d, %s\n", i, extensions[i].extensionName);
 	}
 #endif // !NDEBUG
 }
@@ -905,8 +2618,9 @@ void VulkanDoodler::CreateLogicalDevice()
 	createInfo.pQueueCreateInfos = &queueCreateInfo;
 	createInfo.queueCreateInfoCount = 1;
 	createInfo.pEnabledFeatures = &features;
-	createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	std::vector<const char*> extensions = GetRequiredDeviceExtensions();
+	createInfo.enabledExtensionCount = (uint32_t)extensions.size();
+	createInfo.ppEnabledExtensionNames = extensions.data();
 	//createInfo.pNext = nullptr;
 
 	if (enableValidationLayers)
@@ -925,7 +2639,7 @@ void VulkanDoodler::CreateLogicalDevice()
 	vkGetDeviceQueue(mDevice, indices, 0, &mPresentQueue);
 }
 
-bool VulkanDoodler::GetQueueFamilyFromFlag(VkPhysicalDevice device, uint32_t& index, VkQueueFlagBits flag)
+bool VulkanDoodler::GetQueueFamilyFromFlag(VkPhysicalDevice device, uint32_t& index, VkQueueFlags flags)
 {
 	uint32_t count = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
@@ -933,10 +2647,14 @@ bool VulkanDoodler::GetQueueFamilyFromFlag(VkPhysicalDevice device, uint32_t& in
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
 	for (uint32_t i = 0; i < count; ++i)
 	{
-		if (families[i].queueFlags & flag)
+		//the chart compute pass goes on the same queue as the drawing, so by default this wants both
+		if ((families[i].queueFlags & flags) == flags)
 		{
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+			VkBool32 presentSupport = mSurface == VK_NULL_HANDLE; //nothing to present to when headless
+			if (!presentSupport)
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+			}
 			if (presentSupport)
 			{
 				//TODO do all the fancy shit where there are separate queues in case the user has a shit gpu
@@ -950,17 +2668,54 @@ bool VulkanDoodler::GetQueueFamilyFromFlag(VkPhysicalDevice device, uint32_t& in
 
 void VulkanDoodler::Update()
 {
+	swaggy_assert(!mHeadless && "headless goes through RenderOffscreen");
 	Super::Update();
 
+	auto framestart = std::chrono::steady_clock::now();
+	mPresentBlockMs = 0.0f;
+	if (mLastFrameStart.time_since_epoch().count() != 0)
+	{
+		mProfiler.Add(ProfileStage::Frame, std::chrono::duration<float, std::milli>(framestart - mLastFrameStart).count());
+		float dt = std::chrono::duration<float>(framestart - mLastFrameStart).count();
+		mOrbTime += dt;
+		mBeatPulse *= expf(-dt / kBeatPulseDecay);
+	}
+	mLastFrameStart = framestart;
+
+	if (WasKeyPressed(GLFW_KEY_F1))
+	{
+		mOverlayVisible = !mOverlayVisible;
+	}
+	if (WasKeyPressed(GLFW_KEY_F2))
+	{
+		SetViewMode(mViewMode == ViewMode::Orb ? ViewMode::Chart : ViewMode::Orb);
+	}
+
+	if (IsResize())
+	{
+		//just note it, the swapchain gets rebuilt once the resizing stops (or the driver insists)
+		mResizePending = true;
+		mLastResizeEvent = framestart;
+		ResetResize();
+	}
+
 	if (IsMinimized())
 	{
 		return;
 	}
 
-	vkWaitForFences(mDevice, 1, &mFenceInFlight[mCurrentFrame], VK_TRUE, UINT64_MAX);
+	{
+		ScopedTimer timer(mProfiler, ProfileStage::FenceWait);
+		vkWaitForFences(mDevice, 1, &mFenceInFlight[mCurrentFrame], VK_TRUE, UINT64_MAX);
+	}
+	ReleaseRetiredSwapChains();
 
 	uint32_t imageIndex;
-	VkResult nextImageRes = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, mSemaphoreImageAvailable[mCurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult nextImageRes;
+	{
+		ScopedTimer timer(mProfiler, ProfileStage::Acquire);
+		nextImageRes = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, mSemaphoreImageAvailable[mCurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	}
 	if (nextImageRes == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		ReCreateSwapChain();
@@ -971,11 +2726,57 @@ void VulkanDoodler::Update()
 		swaggy_assert(nextImageRes == VK_SUCCESS || nextImageRes == VK_SUBOPTIMAL_KHR);
 	}
 
+	//the swapchain can hand images back out of order, make sure whatever frame last used this one is done with it
+	if (mImagesInFlight[imageIndex] != VK_NULL_HANDLE)
+	{
+		{
+			ScopedTimer timer(mProfiler, ProfileStage::FenceWait);
+			vkWaitForFences(mDevice, 1, &mImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		}
+		CollectTimestamps(imageIndex);
+	}
+	mImagesInFlight[imageIndex] = mFenceInFlight[mCurrentFrame];
+
+	bool waterfallupload = false;
+	{
+		ScopedTimer timer(mProfiler, ProfileStage::Upload);
+		WriteChartInput(imageIndex);
+		WriteOrbCamera(imageIndex);
+		waterfallupload = RecordUploads(mCurrentFrame, imageIndex);
+	}
+
+	bool overlay = mOverlayVisible && mOverlayDescriptorPool != VK_NULL_HANDLE;
+	if (overlay)
+	{
+		ImGui_ImplVulkan_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+		if (mOverlayDraw)
+		{
+			mOverlayDraw();
+		}
+		ImGui::Render();
+	}
+
 	vkResetFences(mDevice, 1, &mFenceInFlight[mCurrentFrame]);
 
+	//the overlay's vertices change every frame, so it can't live in the pre-recorded buffers
+	VkCommandBuffer commandbuffer = mImageCommandBuffers[imageIndex];
+	if (!mPreRecordCommands || overlay)
+	{
+		swaggy_assert(vkResetCommandBuffer(mCommandBuffer[mCurrentFrame], 0) == VK_SUCCESS);
+		RecordCommandBuffer(mCommandBuffer[mCurrentFrame], imageIndex, overlay);
+		commandbuffer = mCommandBuffer[mCurrentFrame];
+	}
 
-	swaggy_assert(vkResetCommandBuffer(mCommandBuffer[mCurrentFrame], 0) == VK_SUCCESS);
-	RecordCommandBuffer(mCommandBuffer[mCurrentFrame], imageIndex);
+	//the waterfall row (and the gpu fft feeding it) goes in the same submit, ahead of the draw
+	VkCommandBuffer commandbuffers[2];
+	uint32_t commandbuffercount = 0;
+	if (waterfallupload)
+	{
+		commandbuffers[commandbuffercount++] = mUploadCommandBuffers[mCurrentFrame];
+	}
+	commandbuffers[commandbuffercount++] = commandbuffer;
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -984,13 +2785,16 @@ void VulkanDoodler::Update()
 	submitInfo.waitSemaphoreCount = 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &mCommandBuffer[mCurrentFrame];
+	submitInfo.commandBufferCount = commandbuffercount;
+	submitInfo.pCommandBuffers = commandbuffers;
 	VkSemaphore signalSemaphores[] = { mSemaphoreRenderFinish[mCurrentFrame] };
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
-	swaggy_assert(vkQueueSubmit(mDeviceQueue, 1, &submitInfo, mFenceInFlight[mCurrentFrame]) == VK_SUCCESS);
+	{
+		ScopedTimer timer(mProfiler, ProfileStage::Submit);
+		swaggy_assert(vkQueueSubmit(mDeviceQueue, 1, &submitInfo, mFenceInFlight[mCurrentFrame]) == VK_SUCCESS);
+	}
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1001,27 +2805,89 @@ void VulkanDoodler::Update()
 	presentInfo.pImageIndices = &imageIndex;
 	presentInfo.pResults = nullptr;
 
-	VkResult resPresent = vkQueuePresentKHR(mPresentQueue, &presentInfo);
-	if (resPresent == VK_ERROR_OUT_OF_DATE_KHR || resPresent == VK_SUBOPTIMAL_KHR || mResize)
+	VkResult resPresent;
+	{
+		ScopedTimer timer(mProfiler, ProfileStage::Present);
+		auto presentstart = std::chrono::steady_clock::now();
+		resPresent = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+		mPresentBlockMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - presentstart).count();
+	}
+	++mFrameCount;
+	//suboptimal just means stretched, keep presenting that while a resize is still going
+	bool resizesettled = mResizePending && std::chrono::steady_clock::now() - mLastResizeEvent >= kResizeSettleTime;
+	if (resPresent == VK_ERROR_OUT_OF_DATE_KHR || (resPresent == VK_SUBOPTIMAL_KHR && !mResizePending) || resizesettled)
 	{
 		ReCreateSwapChain();
 	}
 	else
 	{
-		swaggy_assert(resPresent == VK_SUCCESS);
+		swaggy_assert(resPresent == VK_SUCCESS || resPresent == VK_SUBOPTIMAL_KHR);
 	}
 	++mCurrentFrame %= MAX_FRAMES_IN_FLIGHT;
 }
 
+void VulkanDoodler::RenderOffscreen(OffscreenFrame& frame)
+{
+	uint32_t target = mCurrentFrame % OffscreenTargetCount();
+	SubmitOffscreen(target);
+	ReadbackOffscreen(target, frame);
+	++mCurrentFrame %= OffscreenTargetCount();
+}
+
+void VulkanDoodler::SubmitOffscreen(uint32_t target)
+{
+	swaggy_assert(mHeadless && target < OffscreenTargetCount());
+
+	//whoever submitted this target last should have read it back by now, this is just to be safe
+	vkWaitForFences(mDevice, 1, &mOffscreenFences[target], VK_TRUE, UINT64_MAX);
+
+	WriteChartInput(target);
+	WriteOrbCamera(target);
+
+	vkResetFences(mDevice, 1, &mOffscreenFences[target]);
+
+	//always the pre-recorded one, render pass + copy to the readback buffer, behind the uploads if there are any
+	VkCommandBuffer commandbuffers[2];
+	uint32_t commandbuffercount = 0;
+	if (RecordUploads(target, target))
+	{
+		commandbuffers[commandbuffercount++] = mUploadCommandBuffers[target];
+	}
+	commandbuffers[commandbuffercount++] = mImageCommandBuffers[target];
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = commandbuffercount;
+	submitInfo.pCommandBuffers = commandbuffers;
+	ScopedTimer timer(mProfiler, ProfileStage::Submit);
+	swaggy_assert(vkQueueSubmit(mDeviceQueue, 1, &submitInfo, mOffscreenFences[target]) == VK_SUCCESS);
+}
+
+void VulkanDoodler::ReadbackOffscreen(uint32_t target, OffscreenFrame& frame)
+{
+	swaggy_assert(mHeadless && target < OffscreenTargetCount());
+	vkWaitForFences(mDevice, 1, &mOffscreenFences[target], VK_TRUE, UINT64_MAX);
+	CollectTimestamps(target);
+
+	frame.width = mSwapExtent.width;
+	frame.height = mSwapExtent.height;
+	frame.pixels.resize((size_t)frame.width * frame.height * 4);
+	memcpy(frame.pixels.data(), mReadbackMapped[target], frame.pixels.size());
+}
+
 void VulkanDoodler::Destroy()
 {
-	Super::Destroy();
+	//tearing everything down, this is the one place a full idle is fine
 	vkDeviceWaitIdle(mDevice);
+	DestroyOverlay(); //imgui hands the glfw callbacks back, so this goes before the window does
+	Super::Destroy();
+	ReleaseRetiredSwapChains(true);
 
 	if (enableValidationLayers)
 	{
 		DestroyDebugUtilsMessengerEXT(mInstance, mDebugMessenger, nullptr);
 	}
+	DestroyImageCommandBuffers();
 	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
 	
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
@@ -1030,9 +2896,19 @@ void VulkanDoodler::Destroy()
 		vkDestroySemaphore(mDevice, mSemaphoreRenderFinish[i], nullptr);
 		vkDestroyFence(mDevice, mFenceInFlight[i], nullptr);
 	}
+	for (auto fence : mOffscreenFences)
+	{
+		vkDestroyFence(mDevice, fence, nullptr);
+	}
+	mOffscreenFences.clear();
 	DestroySwapChain();
-	vkDestroyBuffer(mDevice, mVertexBuffer, nullptr);
-	vkFreeMemory(mDevice, mVertexBufferMemory, nullptr);
+	DestroyOrbBuffers();
+	DestroyOrb();
+	DestroyChartBuffers();
+	DestroyChartCompute();
+	DestroyChartState();
+	DestroyFFTCompute();
+	DestroyWaterfall();
 	vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
 	vkFreeMemory(mDevice, mIndexBufferMemory, nullptr);
 	vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
@@ -1085,7 +2961,7 @@ int VulkanDoodler::ScoreDevice(VkPhysicalDevice device)
 	{
 		return 0;
 	}
-	else if (!CheckDeviceSwapChainSupport(device))
+	else if (!mHeadless && !CheckDeviceSwapChainSupport(device))
 	{
 		return 0;
 	}
@@ -1121,7 +2997,7 @@ uint32_t VulkanDoodler::FindMemoryType(uint32_t filter, VkMemoryPropertyFlags pr
 
 VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDoodler::validationCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageTypes, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
 {
-	printf("validation layer: %s\n", pCallbackData->pMessage);
+	fprintf(stderr, "validation layer: %s\n", pCallbackData->pMessage);
 	return VK_FALSE;
 }
 
@@ -5,16 +5,81 @@
 #include "WindowManager.h"
 #include "vulkan/vulkan.h"
 #include "GLFW/glfw3.h"
+#include "Shaders.h"
+#include "Vertex.h"
+#include "Profiler.h"
+#include "ChartStyle.h"
+#include "ChartLayout.h"
+#include "Analyzer.h"
 #include <vector>
+#include <functional>
+#include <deque>
+#include <chrono>
+
+//a rendered frame copied back to the cpu, tightly packed RGBA8 rows
+struct OffscreenFrame
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+//what the frame shows, F2 flips between them
+enum class ViewMode
+{
+	Orb, //the icosphere, pushed out by the spectrum
+	Chart, //the bars on top of the waterfall
+};
 
 class VulkanDoodler : virtual public WindowManager
 {
 public:
 	typedef WindowManager Super;
 	virtual void Init() override;
+	//no window, surface or swapchain, renders into plain VkImages that get read back to the cpu
+	//works on a software driver like lavapipe, so it runs on display-less boxes and CI
+	void InitHeadless(uint32_t width, uint32_t height, uint32_t targetcount = 1);
 	virtual void Update() override;
 	virtual void Destroy() override;
+	bool IsHeadless() { return mHeadless; };
+	//headless only: blocking render + readback of the current chart
+	void RenderOffscreen(OffscreenFrame& frame);
+	//headless only: the same thing split in two, so several targets can be in flight at once
+	uint32_t OffscreenTargetCount() { return (uint32_t)mSwapImages.size(); };
+	void SubmitOffscreen(uint32_t target);
+	void ReadbackOffscreen(uint32_t target, OffscreenFrame& frame);
+	//cpu timings for update chart/acquire/submit/present plus gpu timestamps, gpu numbers lag a frame or two
+	FrameProfiler& GetProfiler() { return mProfiler; };
 	void UpdateChart(const std::vector<float>& Chart);
+	//gpu fft (fft.comp), windows and transforms the raw samples and feeds the chart and the waterfall straight
+	//from the gpu. stays on until the next UpdateChart, callers should fall back to the cpu when it's not supported
+	bool SupportsGpuFFT(size_t size);
+	void UpdateSamples(const complex_sample& samples, WindowFunction window);
+	//headless only, after ReadbackOffscreen: the raw magnitudes the chart pass got for that target
+	void ReadbackMagnitudes(uint32_t target, std::vector<float>& magnitudes);
+	//smoothing/peak hold/normalization knobs for the chart compute pass, picked up on the next frame
+	void SetChartStyle(const ChartStyle& style) { mChartStyle = style; };
+	const ChartStyle& GetChartStyle() { return mChartStyle; };
+	//rebuilds everything sized by the bar count, waits for the queue to go idle first so don't call it every frame
+	void SetChartBins(uint32_t bins);
+	uint32_t GetChartBins() { return mChartBins; };
+	void SetViewMode(ViewMode mode);
+	ViewMode GetViewMode() { return mViewMode; };
+	//seconds of orb spin, follows the clock when live; headless callers set it per frame so exports come out the same every time
+	void SetOrbTime(float seconds) { mOrbTime = seconds; };
+	//the orb swells a little on a beat and settles back over the next couple of frames, 0 to 1
+	void Pulse(float strength) { mBeatPulse = glm::max(mBeatPulse, strength); };
+	//record one command buffer per swapchain image up front instead of re-recording every frame
+	void SetPreRecordedCommands(bool enable);
+	bool IsPreRecordedCommands() { return mPreRecordCommands; };
+	//dear imgui overlay, draw gets called between NewFrame and Render every frame the overlay is up (F1 toggles it)
+	void SetOverlay(std::function<void()> draw) { mOverlayDraw = draw; };
+	void SetOverlayVisible(bool visible) { mOverlayVisible = visible; };
+	bool IsOverlayVisible() { return mOverlayVisible; };
+	//vkAllocateMemory calls so far, buffers and images alike
+	uint64_t AllocationCount() { return mAllocationCount; };
+	//how long the last Update's present blocked, 0 when it returned before presenting (minimized, out of date)
+	float PresentBlockMs() const { return mPresentBlockMs; };
 private:
 	VkInstance mInstance;
 	VkDebugUtilsMessengerEXT mDebugMessenger;
@@ -22,8 +87,8 @@ private:
 	VkDevice mDevice;
 	VkQueue mDeviceQueue;
 	VkQueue mPresentQueue;
-	VkSurfaceKHR mSurface;
-	VkSwapchainKHR mSwapChain;
+	VkSurfaceKHR mSurface = VK_NULL_HANDLE;
+	VkSwapchainKHR mSwapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> mSwapImages;
 	std::vector<VkImageView> mImageViews;
 	VkFormat mSwapFormat;
@@ -33,54 +98,237 @@ private:
 	VkRenderPass mRenderPass;
 	VkPipeline mGraphicsPipeline;
 	std::vector<VkFramebuffer> mFrameBuffers;
+	//multisampled color + depth shared by every image, the swapchain image is only the resolve target
+	//(with msaa off the color goes straight to the swapchain image and mColorImage stays null)
+	VkSampleCountFlagBits mMsaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	VkFormat mDepthFormat;
+	VkImage mColorImage = VK_NULL_HANDLE;
+	VkDeviceMemory mColorImageMemory;
+	VkImageView mColorImageView;
+	VkImage mDepthImage = VK_NULL_HANDLE;
+	VkDeviceMemory mDepthImageMemory;
+	VkImageView mDepthImageView;
 	VkCommandPool mCommandPool;
-	VkBuffer mVertexBuffer;
-	VkDeviceMemory mVertexBufferMemory;
+	//chart, per swapchain image: a persistently mapped input buffer the raw magnitudes get memcpy'd into right
+	//before that image is submitted, and a device local vertex buffer the compute pass fills from it
+	std::vector<VkBuffer> mChartInputBuffers;
+	std::vector<VkDeviceMemory> mChartInputMemory;
+	std::vector<void*> mChartInputMapped;
+	//the bar layout sits in the same buffer after the magnitudes, copied in lazily once that image is free again
+	std::vector<uint64_t> mChartLayoutWritten;
+	std::vector<VkBuffer> mVertexBuffers;
+	std::vector<VkDeviceMemory> mVertexBufferMemory;
+	std::vector<VkDescriptorSet> mChartDescriptorSets;
+	//smoothed levels, peaks and the running max, only ever touched by the compute pass
+	VkBuffer mChartState;
+	VkDeviceMemory mChartStateMemory;
+	VkDescriptorSetLayout mChartSetLayout;
+	VkDescriptorPool mChartDescriptorPool;
+	VkPipelineLayout mChartPipelineLayout;
+	VkPipeline mChartPipeline;
+	std::vector<float> mChartMagnitudes;
+	ChartStyle mChartStyle;
+	uint32_t mChartBins = (uint32_t)kDefaultChartBins;
+	std::vector<ChartBar> mChartLayout; //at most one bar per pixel column
+	uint64_t mChartLayoutVersion = 0;
+	VkDeviceSize mChartLayoutOffset = 0;
+	//shared by the bars and the peak ticks, 16 bit until the vertex count doesn't fit anymore
 	VkBuffer mIndexBuffer;
 	VkDeviceMemory mIndexBufferMemory;
+	VkIndexType mIndexType = VK_INDEX_TYPE_UINT16;
+	uint32_t mIndexCount = 0;
+	//orb: the mesh goes up once into device local memory, per frame only the camera changes (the bands are the
+	//chart state above), so the cpu side costs the same whatever the subdivision level
+	ViewMode mViewMode = ViewMode::Orb;
+	float mOrbTime = 0.0f;
+	float mBeatPulse = 0.0f;
+	uint32_t mOrbIndexCount = 0;
+	VkBuffer mOrbVertexBuffer;
+	VkDeviceMemory mOrbVertexBufferMemory;
+	VkBuffer mOrbIndexBuffer;
+	VkDeviceMemory mOrbIndexBufferMemory;
+	std::vector<VkBuffer> mOrbCameraBuffers; //per swapchain image, mapped
+	std::vector<VkDeviceMemory> mOrbCameraMemory;
+	std::vector<void*> mOrbCameraMapped;
+	std::vector<VkDescriptorSet> mOrbDescriptorSets;
+	VkDescriptorSetLayout mOrbSetLayout;
+	VkDescriptorPool mOrbDescriptorPool;
+	VkPipelineLayout mOrbPipelineLayout;
+	VkPipeline mOrbPipeline;
 	std::vector<VkCommandBuffer> mCommandBuffer;
+	std::vector<VkCommandBuffer> mImageCommandBuffers; //pre-recorded, one per swapchain image
+	std::vector<VkFence> mImagesInFlight; //fence of the frame currently using each swapchain image
+	//waterfall: a R16_SFLOAT ring buffer of spectra, one row gets copied in per frame and the head wraps around
+	uint32_t mWaterfallRows = 0;
+	uint32_t mWaterfallHead = 0; //newest row
+	std::vector<uint16_t> mWaterfallRow; //next row to upload, half floats
+	std::vector<float> mWaterfallLevels; //scratch for building it
+	bool mWaterfallDirty = false;
+	VkImage mWaterfallImage = VK_NULL_HANDLE;
+	VkDeviceMemory mWaterfallImageMemory;
+	VkImageView mWaterfallImageView;
+	VkImage mColormapImage = VK_NULL_HANDLE;
+	VkDeviceMemory mColormapImageMemory;
+	VkImageView mColormapImageView;
+	VkSampler mWaterfallSampler;
+	VkBuffer mWaterfallParams; //device local, the head gets updated with vkCmdUpdateBuffer in the upload command buffer
+	VkDeviceMemory mWaterfallParamsMemory;
+	//one staging row + upload command buffer per frame in flight (per target when headless)
+	std::vector<VkBuffer> mWaterfallStaging;
+	std::vector<VkDeviceMemory> mWaterfallStagingMemory;
+	std::vector<void*> mWaterfallStagingMapped;
+	std::vector<VkCommandBuffer> mUploadCommandBuffers;
+	//gpu fft, per frame in flight (per target when headless): the mapped raw samples and a descriptor set
+	//that gets pointed at whichever image's chart input the frame lands on
+	static const size_t kGpuFFTMaxSize = 4096; //32KB of shared memory
+	std::vector<VkBuffer> mFFTInputBuffers;
+	std::vector<VkDeviceMemory> mFFTInputMemory;
+	std::vector<void*> mFFTInputMapped;
+	std::vector<VkDescriptorSet> mFFTDescriptorSets;
+	VkDescriptorSetLayout mFFTSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool mFFTDescriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout mFFTPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline mFFTPipeline = VK_NULL_HANDLE; //stays null when the device can't run it
+	std::vector<float> mFFTSamples; //latest window, transformed again every frame until UpdateChart takes over
+	WindowFunction mFFTWindow = WindowFunction::Rectangular;
+	bool mGpuFFTActive = false;
+	VkDescriptorSetLayout mWaterfallSetLayout;
+	VkDescriptorPool mWaterfallDescriptorPool;
+	VkDescriptorSet mWaterfallDescriptorSet;
+	VkPipelineLayout mWaterfallPipelineLayout;
+	VkPipeline mWaterfallPipeline;
+	bool mPreRecordCommands = true;
 	std::vector<VkSemaphore> mSemaphoreImageAvailable;
 	std::vector<VkSemaphore> mSemaphoreRenderFinish;
 	std::vector<VkFence> mFenceInFlight;
 	uint32_t mCurrentFrame = 0;
+	uint64_t mFrameCount = 0; //frames submitted so far
+	//everything hanging off a swapchain that got replaced, kept alive until the frames that used it are done
+	struct RetiredSwapChain
+	{
+		uint64_t frame = 0; //mFrameCount when it got retired
+		VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkImage> images; //the msaa color and depth targets
+		std::vector<VkDeviceMemory> imageMemory;
+		std::vector<VkFramebuffer> frameBuffers;
+		std::vector<VkCommandBuffer> commandBuffers;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::vector<VkBuffer> chartInputBuffers;
+		std::vector<VkDeviceMemory> chartInputMemory;
+		std::vector<VkBuffer> vertexBuffers;
+		std::vector<VkDeviceMemory> vertexBufferMemory;
+		std::vector<VkDescriptorSet> chartDescriptorSets;
+		std::vector<VkBuffer> orbCameraBuffers;
+		std::vector<VkDeviceMemory> orbCameraMemory;
+		std::vector<VkDescriptorSet> orbDescriptorSets;
+	};
+	std::deque<RetiredSwapChain> mRetiredSwapChains;
+	bool mResizePending = false;
+	std::chrono::steady_clock::time_point mLastResizeEvent;
+	//headless render targets stand in for the swapchain images, everything per-image just works on them
+	bool mHeadless = false;
+	uint32_t mOffscreenTargetCount = 1;
+	std::vector<VkDeviceMemory> mOffscreenImageMemory;
+	std::vector<VkBuffer> mReadbackBuffers;
+	std::vector<VkDeviceMemory> mReadbackMemory;
+	std::vector<void*> mReadbackMapped;
+	std::vector<VkFence> mOffscreenFences;
+	//timestamp queries, kQueriesPerImage per swapchain image so the pre-recorded buffers can own theirs
+	FrameProfiler mProfiler;
+	VkQueryPool mQueryPool = VK_NULL_HANDLE;
+	float mTimestampPeriod = 0.0f; //ns per tick
+	uint64_t mTimestampMask = 0;
+	std::chrono::steady_clock::time_point mLastFrameStart;
+	uint64_t mAllocationCount = 0;
+	float mPresentBlockMs = 0.0f;
+	//overlay
+	VkDescriptorPool mOverlayDescriptorPool = VK_NULL_HANDLE;
+	std::function<void()> mOverlayDraw;
+	bool mOverlayVisible = false;
 private:
 	//init
+	void InitVulkan();
 	void CreateInstance();
 	void SetupMessengerCallback();
 	void GetBestGraphicsDevice();
 	void CreateLogicalDevice();
 	void CreateSurface();
 	void CreateSwapChain();
+	void CreateOffscreenTargets();
+	void CreateReadbackBuffers();
 	void CreateImageViews();
+	void CreateRenderTargets();
 	void CreateGraphicsPipeline();
 	void CreateRenderPass();
 	void CreateFrameBuffers();
 	void CreateCommandPool();
-	void CreateVertexBuffer();
+	void CreateChartCompute();
+	void CreateChartState();
+	void CreateChartBuffers();
 	void CreateIndexBuffer();
+	void CreateOrb();
+	void CreateOrbPipeline();
+	void CreateOrbBuffers();
+	void CreateWaterfall();
+	void CreateWaterfallPipeline();
+	void CreateFFTCompute();
 	void CreateCommandBuffer();
+	void CreateImageCommandBuffers();
+	void CreateQueryPool();
 	void CreateSyncObjects();
+	void CreateOverlay();
 	void ReCreateSwapChain();
 
 	//destroy
 	void DestroySwapChain();
+	void DestroyOffscreenTargets();
+	void DestroyRenderTargets();
+	void DestroyChartCompute();
+	void DestroyChartState();
+	void DestroyChartBuffers();
+	void DestroyOrb();
+	void DestroyOrbBuffers();
+	void DestroyWaterfall();
+	void DestroyFFTCompute();
+	void DestroyImageCommandBuffers();
+	void DestroyOverlay();
+	void ReleaseRetiredSwapChains(bool force = false);
 
 	bool IsMinimized();
 
 	//writing/drawing
-	void RecordCommandBuffer(VkCommandBuffer commandbuffer, uint32_t imageIndex);
+	void RecordCommandBuffer(VkCommandBuffer commandbuffer, uint32_t imageIndex, bool withOverlay = false);
+	void RecordImageCommandBuffers();
+	bool RecordUploads(uint32_t slot, uint32_t imageIndex);
+	void RecordFFT(VkCommandBuffer commandbuffer, uint32_t slot, uint32_t imageIndex);
+	void WriteChartInput(uint32_t imageIndex);
+	void UpdateChartLayout();
+	void WriteOrbCamera(uint32_t imageIndex);
+	void CollectTimestamps(uint32_t imageIndex);
 	void CopyBuffer(VkBuffer dst, VkBuffer src, VkDeviceSize size);
+	VkCommandBuffer BeginSingleTimeCommands();
+	void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
 
 	//init helpers / callbacks
 	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory);
-	VkShaderModule CreateShaderModule(const std::vector<char>& code);
+	//device local buffer filled through a throwaway staging buffer, for stuff that never changes
+	void CreateStaticBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory);
+	void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& memory,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+	VkSampleCountFlagBits ChooseSampleCount();
+	VkFormat ChooseDepthFormat();
+	VkShaderModule CreateShaderModule(const ShaderCode& code);
 	void GetSwapChainImages(std::vector<VkImage>& images);
+	std::vector<const char*> GetRequiredInstanceExtensions();
+	std::vector<const char*> GetRequiredDeviceExtensions();
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 	bool CheckDeviceSwapChainSupport(VkPhysicalDevice device);
 	VkSurfaceFormatKHR ChooseSurfaceFormat();
 	VkPresentModeKHR ChoosePresentMode();
 	VkExtent2D ChooseSwapExtent();
-	bool GetQueueFamilyFromFlag(VkPhysicalDevice device, uint32_t& index, VkQueueFlagBits flag = VK_QUEUE_GRAPHICS_BIT);
+	bool GetQueueFamilyFromFlag(VkPhysicalDevice device, uint32_t& index, VkQueueFlags flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 	bool CheckValidationLayerSupported();
 	int ScoreDevice(VkPhysicalDevice device);
 	uint32_t FindMemoryType(uint32_t filter, VkMemoryPropertyFlags propFlags);
@@ -1,4 +1,5 @@
 #include "WASAPILoopbackCapture.h"
+#include "Trace.h"
 #include <mmdeviceapi.h>
 #include <AudioClient.h>
 #include <AudioPolicy.h>
@@ -30,7 +31,7 @@ void LShiftArray(T (&a)[size], size_t numshifts)
 
 	size_t keep = size - numshifts; // amount we're keeping from the original array
 	memmove(&a[0], &a[numshifts], sizeof(T) * keep);
-	memset(&a[keep], 0, numshifts);
+	memset(&a[keep], 0, sizeof(T) * numshifts);
 }
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
@@ -92,14 +93,25 @@ bool WASAPILoopbackCapture::Capture()
 	hr = mpCaptureClient->GetNextPacketSize(&packetLength);
 	RETURN_ON_FAIL(hr);
 
+	mLastQueueDepth = 0;
 	while (packetLength != 0)
 	{
+		TRACE_SCOPE("capture packet");
 		hr = mpCaptureClient->GetBuffer(&pData, &numFramesAvailable, &flags, NULL, NULL);
 		RETURN_ON_FAIL(hr);
+		++mLastQueueDepth;
+
+		if (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY)
+		{
+			++mDroppedPackets;
+		}
 
 		if(flags & AUDCLNT_BUFFERFLAGS_SILENT)
 		{
-			pData = nullptr;
+			//the packet is all zeros, shift those in so the spectrum actually falls silent instead of freezing on the last sound
+			++mSilentPackets;
+			LShiftArray(mSample, packetLength * mpwfx->nChannels);
+			mSamplesCollected += packetLength;
 		}
 		else //copy data to buffer
 		{
@@ -153,9 +165,16 @@ bool WASAPILoopbackCapture::Destroy()
 	return true;
 }
 
-complex_sample WASAPILoopbackCapture::GetSample(bool leftchannel)
+complex_sample WASAPILoopbackCapture::GetSample(bool leftchannel, size_t count)
 {
 	complex_sample sample;
+	GetSample(sample, leftchannel, count);
+	return sample;
+}
+
+void WASAPILoopbackCapture::GetSample(complex_sample& sample, bool leftchannel, size_t count)
+{
+	sample.clear();
 	//channels are interlaced between eachother on the buffer,
 	// eg [l, r, l, r, l, r, ...] 
 	//naturally, we only care about one channel at a time
@@ -163,11 +182,16 @@ complex_sample WASAPILoopbackCapture::GetSample(bool leftchannel)
 	int start = leftchannel ? 0 : (numchannels - 1);
 	
 	if (numchannels <= 0 || mSamplesCollected == 0)
-		return sample;
+		return;
 
+	//the newest samples are at the end of the buffer, only walk the last count frames
+	size_t frames = kFullSampleSize / numchannels;
+	if (count < frames)
+		start += (int)((frames - count) * numchannels);
+
+	sample.reserve(count);
 	for (int i = start, dstindex = 0; i < kFullSampleSize; i += numchannels, ++dstindex)
 	{
 		sample.emplace_back(mSample[i], 0.0f);
 	}
-	return sample;
 }
\ No newline at end of file
@@ -10,13 +10,19 @@ class WASAPILoopbackCapture
 {
 public:
 	static const size_t kSampleSize = 2048;
-	static const size_t kFullSampleSize = kSampleSize * 2; // sample on two channels
+	static const size_t kMaxSampleSize = 8192; // the most GetSample can hand out, for bigger ffts
+	static const size_t kFullSampleSize = kMaxSampleSize * 2; // sample on two channels
 	WASAPILoopbackCapture();
 	bool Init();
 	bool Capture();
 	bool Destroy();
-	complex_sample GetSample(bool leftchannel = false);
+	complex_sample GetSample(bool leftchannel = false, size_t count = kSampleSize); //the latest count frames
+	void GetSample(complex_sample& out, bool leftchannel, size_t count); //same, into out without reallocating it
 	unsigned SampleRate() { return mpwfx->nSamplesPerSec; };
+	size_t SamplesCollected() { return mSamplesCollected; };
+	unsigned LastQueueDepth() { return mLastQueueDepth; }; //packets that were waiting on the last Capture()
+	uint64_t DroppedPackets() { return mDroppedPackets; }; //packets flagged with a discontinuity, ie we were too slow
+	uint64_t SilentPackets() { return mSilentPackets; };
 private:
 	IMMDeviceEnumerator* mpEnumerator = nullptr;
 	IMMDevice* mpDevice = nullptr;
@@ -26,6 +32,9 @@ private:
 	REFERENCE_TIME mhnsActualDuration = 0;
 	float mSample[kFullSampleSize];
 	size_t mSamplesCollected = 0;
+	unsigned mLastQueueDepth = 0;
+	uint64_t mDroppedPackets = 0;
+	uint64_t mSilentPackets = 0;
 };
 
 #endif // WASAPI_LOOPBACK_CAPTURE
\ No newline at end of file
@@ -11,6 +11,7 @@ void WindowManager::Init()
 
 	glfwSetWindowUserPointer(mWindow, this);
 	glfwSetWindowSizeCallback(mWindow, FramebufferSizeCallback);
+	glfwSetKeyCallback(mWindow, KeyCallback);
 
 	assert(mWindow != nullptr);
 }
@@ -18,6 +19,7 @@ void WindowManager::Init()
 void WindowManager::Update()
 {
 	assert(mWindow != nullptr);
+	mPressedKeys.clear();
 	if (!glfwWindowShouldClose(mWindow))
 	{
 		glfwPollEvents();
@@ -28,9 +30,23 @@ void WindowManager::Update()
 	}
 }
 
+void WindowManager::WaitEvents(double timeout)
+{
+	assert(mWindow != nullptr);
+	glfwWaitEventsTimeout(timeout);
+	if (glfwWindowShouldClose(mWindow))
+	{
+		mQuit = true;
+	}
+}
+
 void WindowManager::Destroy()
 {
-	glfwDestroyWindow(mWindow);
+	if (mWindow != nullptr) //headless never made one
+	{
+		glfwDestroyWindow(mWindow);
+		mWindow = nullptr;
+	}
 	glfwTerminate();
 }
 
@@ -42,3 +58,35 @@ void WindowManager::FramebufferSizeCallback(GLFWwindow* window, int width, int h
 		windowuser->mResize = true;
 	}
 }
+
+
+void WindowManager::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	auto windowuser = reinterpret_cast<WindowManager*>(glfwGetWindowUserPointer(window));
+	if (windowuser != nullptr && action == GLFW_PRESS)
+	{
+		windowuser->mPressedKeys.push_back(key);
+	}
+}
+
+bool WindowManager::WasKeyPressed(int key)
+{
+	for (int pressed : mPressedKeys)
+	{
+		if (pressed == key)
+			return true;
+	}
+	return false;
+}
+
+float WindowManager::RefreshRate()
+{
+	//glfw only hands out the window's monitor in fullscreen, windowed it's the primary one
+	GLFWmonitor* monitor = mWindow != nullptr ? glfwGetWindowMonitor(mWindow) : nullptr;
+	if (monitor == nullptr)
+		monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode* mode = monitor != nullptr ? glfwGetVideoMode(monitor) : nullptr;
+	if (mode == nullptr || mode->refreshRate <= 0)
+		return 60.0f;
+	return (float)mode->refreshRate;
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define WINDOW_MANAGER_H
 
 #include "GLFW/glfw3.h"
+#include <vector>
 
 class WindowManager
 {
@@ -13,12 +14,19 @@ public:
 	virtual void Destroy();
 	bool IsQuit() { return mQuit; };
 	bool IsResize() { return mResize; };
-	bool ResetResize() { mResize = false; };
+	void ResetResize() { mResize = false; };
+	bool WasKeyPressed(int key); //true once per press of a GLFW_KEY_*, since the last Update
+	bool HasInput() { return !mPressedKeys.empty(); }; //any key pressed since the last Update
+	//blocks until a window event, glfwPostEmptyEvent from any thread, or the timeout. keys pile up for the next Update
+	void WaitEvents(double timeout);
+	float RefreshRate(); //of the monitor the window is on (or the primary one), 60 if glfw can't tell
 protected:
-	GLFWwindow* mWindow;
-	bool mQuit;
-	bool mResize;
+	GLFWwindow* mWindow = nullptr;
+	bool mQuit = false;
+	bool mResize = false;
+	std::vector<int> mPressedKeys;
 	static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 
 };
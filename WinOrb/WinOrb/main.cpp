@@ -1,30 +1,259 @@
-#include "WASAPILoopbackCapture.h"
 #include "WindowManager.h"
 #include "VulkanDoodler.h"
-#include "FFT.h"
+#include "VideoExporter.h"
+#include "Analyzer.h"
+#include "Overlay.h"
+#include "Bench.h"
+#include "FramePacer.h"
+#include "FramePipeline.h"
+#include "ListenClient.h"
+#include "Trace.h"
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
 
-int main()
+//WinOrb.exe --export <track.wav> <out.y4m | -> [--raw] [--size WxH] [--fps N] [--inflight N]
+int RunExport(int argc, char** argv)
 {
-	CoInitialize(NULL);
+	WavData audio;
+	if (!readwav(argv[2], audio))
+	{
+		fprintf(stderr, "couldn't read %s, only plain PCM/float wavs are supported\n", argv[2]);
+		return 1;
+	}
+
+	ExportSettings settings;
+	settings.outpath = argv[3];
+	for (int i = 4; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--raw") == 0)
+			settings.format = ExportFormat::RawRGBA;
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+			sscanf_s(argv[++i], "%ux%u", &settings.width, &settings.height);
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			settings.fps = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--inflight") == 0 && i + 1 < argc)
+			settings.inflight = (uint32_t)atoi(argv[++i]);
+	}
+
+	VideoExporter exporter;
+	return exporter.Export(audio, settings) ? 0 : 1;
+}
+
+//WinOrb.exe --fftcheck
+//runs fft.comp headless (a software driver like lavapipe is fine) against the cpu fft for every size and window
+int RunFFTCheck()
+{
+	VulkanDoodler doodler;
+	doodler.InitHeadless(64, 64);
+	const float tolerance = 1e-3f; //relative to the loudest bin
+	int failures = 0;
+	for (size_t size = AnalysisSettings::kMinFFTSize; size <= AnalysisSettings::kMaxFFTSize; size *= 2)
+	{
+		if (!doodler.SupportsGpuFFT(size))
+		{
+			fprintf(stderr, "fft %5zu: cpu only on this device\n", size);
+			continue;
+		}
+		for (int window = 0; window < (int)WindowFunction::Count; ++window)
+		{
+			//a few tones that don't land on bin centers plus some noise, same every run
+			complex_sample samples(size);
+			uint32_t seed = 12345;
+			for (size_t i = 0; i < size; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				float noise = (seed >> 8) / (float)(1 << 24) - 0.5f;
+				float val = 0.5f * sinf(0.05f * i) + 0.25f * sinf(0.731f * i) + 0.1f * sinf(2.9f * i) + 0.05f * noise;
+				samples[i] = fcomplex(val, 0.0f);
+			}
+
+			doodler.UpdateSamples(samples, (WindowFunction)window);
+			OffscreenFrame frame;
+			doodler.SubmitOffscreen(0);
+			doodler.ReadbackOffscreen(0, frame);
+			std::vector<float> gpu;
+			doodler.ReadbackMagnitudes(0, gpu);
+
+			AnalysisSettings settings;
+			settings.fftSize = size;
+			settings.window = (WindowFunction)window;
+			std::vector<float> cpu;
+			FrameArena arena;
+			AnalyzeSpectrum(samples, settings, cpu, arena);
+
+			float peak = 0.0f;
+			float maxerr = 0.0f;
+			for (size_t i = 0; i < cpu.size(); ++i)
+			{
+				peak = std::max(peak, cpu[i]);
+				maxerr = std::max(maxerr, fabsf(cpu[i] - gpu[i]));
+			}
+			float relerr = peak > 0.0f ? maxerr / peak : maxerr;
+			bool ok = relerr <= tolerance;
+			failures += ok ? 0 : 1;
+			fprintf(stderr, "fft %5zu %-12s max rel err %.2e %s\n", size, WindowFunctionName((WindowFunction)window), relerr, ok ? "ok" : "MISMATCH");
+		}
+	}
+	doodler.Destroy();
+	return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 4 && strcmp(argv[1], "--export") == 0)
+	{
+		return RunExport(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--fftcheck") == 0)
+	{
+		return RunFFTCheck();
+	}
+	if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+	{
+		return RunBench(argc >= 3 ? argv[2] : nullptr);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--listen") == 0)
+	{
+		return RunListen();
+	}
+	//--profile dumps the frame profiler to stderr every few seconds
+	//--publish puts every analyzed frame in shared memory for other processes, see SpectrumShm.h
+	//--record <out.wos> [--bits 16] writes every analyzed frame to a spectrum recording, see SpectrumRecording.h
+	//--trace <out.json> writes a chrome trace of the last couple of minutes on exit, see Trace.h
+	bool logprofile = false;
+	bool publish = false;
+	const char* recordpath = nullptr;
+	uint32_t recordbits = 8;
+	const char* tracepath = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		logprofile |= strcmp(argv[i], "--profile") == 0;
+		publish |= strcmp(argv[i], "--publish") == 0;
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordpath = argv[++i];
+		else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc)
+			recordbits = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracepath = argv[++i];
+	}
+	TRACE_THREAD("render");
+	if (tracepath != nullptr)
+		TraceStart();
 
-	WASAPILoopbackCapture device;
 	VulkanDoodler doodler;
-	device.Init();
 	doodler.Init();
+	AnalysisSettings analysis;
+	ChartStyle chartstyle = MakeChartStyle(ChartPreset::Smooth);
+	PacingSettings pacing;
+	FramePacer pacer;
+	pacer.SetRefreshRate(doodler.RefreshRate());
+	OverlayStats overlaystats;
+	overlaystats.profiler = &doodler.GetProfiler();
+	overlaystats.pacer = &pacer;
+	doodler.SetOverlay([&]()
+	{
+		if (DrawPerfOverlay(overlaystats, analysis, chartstyle, pacing))
+			doodler.SetChartStyle(chartstyle);
+	});
+
+	//capture and analysis run on their own threads, this one just renders whatever's newest
+	SpectrumPublisher publisher;
+	SpectrumRecorder recorder;
+	FramePipeline pipeline;
+	if (publish && publisher.Open())
+		pipeline.SetPublisher(&publisher);
+	if (recordpath != nullptr && recorder.Open(recordpath, recordbits))
+		pipeline.SetRecorder(&recorder);
+	//sound coming back wakes the idle wait below straight away
+	pipeline.Start(analysis, [&](size_t size) { return doodler.SupportsGpuFFT(size); }, []() { glfwPostEmptyEvent(); });
+
+	uint64_t lastbeats = 0;
+	auto lastlog = std::chrono::steady_clock::now();
+	auto lastinput = lastlog;
 	while (!doodler.IsQuit())
 	{
-		Sleep(16);
-		device.Capture();
-		complex_sample samples = device.GetSample();
-		complex_sample frequency = FFT(samples);
-		std::vector<float> magnitudes = ToMagnitude(frequency);
-		magnitudes.resize(1024);
-		doodler.UpdateChart(magnitudes);
+		//nothing but silence for a while and nobody touching the window, stop drawing the same frame over and over
+		//and just sit on window events. a key press gets a fresh idleAfter worth of frames
+		auto now = std::chrono::steady_clock::now();
+		if (doodler.HasInput())
+			lastinput = now;
+		bool idle = analysis.idleAfter > 0.0f && pipeline.SilentSeconds() > analysis.idleAfter
+			&& std::chrono::duration<float>(now - lastinput).count() > analysis.idleAfter;
+		if (idle)
+		{
+			doodler.WaitEvents(0.25);
+			continue;
+		}
+
+		TRACE_SCOPE("frame");
+		FrameHeapCheck heapcheck("render");
+		pacer.SetSettings(pacing);
+		doodler.GetProfiler().Add(ProfileStage::Pacing, pacer.WaitForFrame());
+		pipeline.SetSettings(analysis);
+		bool fresh = false;
+		const FramePacket* packet = pipeline.Latest(fresh);
+		if (packet != nullptr)
+		{
+			if (fresh)
+			{
+				FrameProfiler& profiler = doodler.GetProfiler();
+				profiler.Add(ProfileStage::Capture, packet->captureMs);
+				profiler.Add(ProfileStage::Analysis, packet->analysisMs);
+				profiler.Add(ProfileStage::Latency, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - packet->captured).count());
+			}
+			//the same packet again when nothing new came in, the chart still animates off it
+			if (packet->gpuFFT)
+				doodler.UpdateSamples(packet->samples, packet->window);
+			else
+				doodler.UpdateChart(packet->magnitudes);
+			overlaystats.captureQueueDepth = packet->captureQueueDepth;
+			overlaystats.droppedPackets = packet->droppedPackets;
+			overlaystats.silentPackets = packet->silentPackets;
+			overlaystats.gpuFFTActive = packet->gpuFFT;
+			overlaystats.rhythm = packet->rhythm;
+			overlaystats.pitch = packet->pitch;
+			//however many beats went by since the last packet this thread saw, it's one pulse
+			if (packet->rhythm.beats != lastbeats && packet->rhythm.confidence > 0.0f)
+				doodler.Pulse(std::min(1.0f, 0.5f + packet->rhythm.confidence));
+			lastbeats = packet->rhythm.beats;
+		}
+
+		//not from inside the overlay callback, that runs in the middle of recording the frame
+		if (analysis.chartBins != doodler.GetChartBins())
+			doodler.SetChartBins((uint32_t)analysis.chartBins);
+
+		overlaystats.deviceAllocations = doodler.AllocationCount();
+		overlaystats.staleFrames = pipeline.StaleDrops();
 		doodler.Update();
+		//only this frame's present, blocking there is vsync. fence and acquire waits are the gpu falling behind and
+		//the profiler's last values could be from an earlier frame when Update bailed out before presenting
+		pacer.EndFrame(doodler.PresentBlockMs());
+
+		if (logprofile && std::chrono::steady_clock::now() - lastlog > std::chrono::seconds(5))
+		{
+			doodler.GetProfiler().Log(stderr);
+			lastlog = std::chrono::steady_clock::now();
+		}
+	}
+
+	pipeline.Stop();
+	if (tracepath != nullptr)
+	{
+		TraceStop();
+		TraceWrite(tracepath);
+	}
+	if (recorder.IsOpen())
+	{
+		uint64_t frames = recorder.Frames();
+		recorder.Close();
+		fprintf(stderr, "recorded %llu frames into %s, %.1f bytes per frame\n", (unsigned long long)frames, recordpath,
+			frames > 0 ? recorder.BytesWritten() / (double)frames : 0.0);
 	}
-	
-	device.Destroy();
 	doodler.Destroy();
 	return 0;
 }
\ No newline at end of file
@@ -1,9 +1,5 @@
-%VULKAN_SDK%\Bin\glslc shader.vert -o vert.spv
-%VULKAN_SDK%\Bin\glslc shader.frag -o frag.spv
-
-::I'm unsure if I need to compile two different sets of shaders for 32 and 64 bits
-::eventually I'll want to copy the shaders over to all the different working directories
-xcopy *.spv ..\WinOrb\shaders\ /y
-xcopy *.spv ..\x64\Debug\shaders\ /y
+::the shaders get compiled and embedded into the exe when building the solution (see the CustomBuild items in WinOrb.vcxproj),
+::this is only for iterating on shaders without a rebuild: set WINORB_SHADER_DIR to this folder and the .spv files here win
+for %%f in (*.vert *.frag *.comp) do %VULKAN_SDK%\Bin\glslc %%f -o %%f.spv
 
 pause
\ No newline at end of file
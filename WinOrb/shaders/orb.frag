@@ -0,0 +1,25 @@
+#version 450
+
+layout(binding = 0) uniform OrbCamera {
+    mat4 viewProj;
+    mat4 model;
+    vec4 lightDir;
+    float amplitude;
+    uint bins;
+    float time;
+    float pulse; //beat pulse, 0 to 1
+} camera;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in float fragLevel;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 normal = normalize(fragNormal);
+    float diffuse = max(dot(normal, normalize(camera.lightDir.xyz)), 0.0);
+    //louder bands run hotter
+    vec3 base = mix(fragColor, vec3(1.0, 0.9, 0.6), clamp(fragLevel, 0.0, 1.0));
+    outColor = vec4(base * (0.25 + 0.75 * diffuse), 1.0);
+}
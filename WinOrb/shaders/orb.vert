@@ -0,0 +1,48 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition; //unit sphere, doubles as the normal
+layout(location = 1) in vec3 inColor;
+
+//OrbCamera on the cpu, the only thing besides the bands that changes per frame
+layout(binding = 0) uniform OrbCamera {
+    mat4 viewProj;
+    mat4 model;
+    vec4 lightDir;
+    float amplitude; //how far out a full scale band pushes the surface
+    uint bins;
+    float time;
+    float pulse; //beat pulse, 0 to 1
+} camera;
+
+//the chart pass's smoothed levels double as the bands, straight from the gpu
+layout(std430, binding = 1) readonly buffer ChartState {
+    float runningMax;
+    float pad0;
+    float pad1;
+    float pad2;
+    vec4 state[]; //level, peak, peak age, pad
+} chart;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out float fragLevel;
+
+//pole to pole is the same log frequency axis the bars use left to right
+float bandLevel(vec3 dir) {
+    float along = acos(clamp(dir.y, -1.0, 1.0)) / 3.14159265;
+    float bin = clamp(exp2(along * log2(float(camera.bins))), 1.0, float(camera.bins - 1));
+    uint lo = uint(bin);
+    uint hi = min(lo + 1, camera.bins - 1);
+    return mix(chart.state[lo].x, chart.state[hi].x, fract(bin));
+}
+
+void main() {
+    float level = bandLevel(inPosition);
+    //a beat swells the whole orb a touch on top of the bands
+    vec3 displaced = inPosition * (1.0 + camera.amplitude * level) * (1.0 + 0.06 * camera.pulse);
+    vec4 world = camera.model * vec4(displaced, 1.0);
+    gl_Position = camera.viewProj * world;
+    fragNormal = mat3(camera.model) * inPosition;
+    fragColor = inColor;
+    fragLevel = level;
+}
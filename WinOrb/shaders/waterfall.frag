@@ -0,0 +1,31 @@
+#version 450
+
+layout(binding = 0) uniform WaterfallParams {
+    uint head;
+    uint rows;
+    uint visibleRows;
+    uint bins;
+    vec4 rect;
+} params;
+
+layout(binding = 1) uniform sampler2D history;
+layout(binding = 2) uniform sampler2D colormap;
+
+layout(location = 0) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    //same log frequency axis as the bars, x = log10(bin) / 3.01
+    float bin = pow(10.0, fragUV.x * 3.01);
+    float u = (bin + 0.5) / float(params.bins);
+
+    //newest row at the top, older ones further down, wrapping around the ring
+    //v always lands on a row center so the linear filter only blends along the frequency axis
+    float age = floor(fragUV.y * float(params.visibleRows));
+    float row = mod(float(params.head) - age + float(params.rows), float(params.rows));
+    float v = (row + 0.5) / float(params.rows);
+
+    float level = texture(history, vec2(u, v)).r;
+    outColor = texture(colormap, vec2(clamp(level, 0.0, 1.0), 0.5));
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout(binding = 0) uniform WaterfallParams {
+    uint head;
+    uint rows;
+    uint visibleRows;
+    uint bins;
+    vec4 rect; //x0, y0, x1, y1 in clip space
+} params;
+
+layout(location = 0) out vec2 fragUV;
+
+//two triangles straight from gl_VertexIndex, no vertex buffer
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    gl_Position = vec4(mix(params.rect.xy, params.rect.zw, corner), 0.0, 1.0);
+    fragUV = corner;
+}